@@ -0,0 +1,919 @@
+/*
+ * This file is part of BIRD-RTRlib-CLI.
+ *
+ * BIRD-RTRlib-CLI is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * BIRD-RTRlib-CLI is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with BIRD-RTRlib-CLI; see the file COPYING.
+ *
+ * written by smlng and Mehmet Ceyran, in cooperation with:
+ * CST group, Freie Universitaet Berlin
+ * Website: https://github.com/rtrlib/bird-rtrlib-cli
+ */
+
+
+/*
+ * Benchmark driver for the perf regression tests. Every scenario runs
+ * against a mock BIRD control socket served by this driver and synthetic VRP
+ * sets, and its results are compared with a baseline file:
+ *
+ *  full-load   replay of a full VRP set to BIRD as fast as possible
+ *  churn       replay of withdrawals and announcements of a VRP set
+ *  reconnect   full-load with BIRD dropping the connection periodically
+ *  validate    bulk validation of synthetic routes against a VRP set
+ *  vrp-store   memory use, insert and lookup rates of the VRP store
+ *
+ * Metrics ending in "_us" are latencies and metrics starting with "bytes_"
+ * are memory sizes (lower is better), all others are rates (higher is
+ * better). A metric regresses if it is worse than the
+ * baseline by more than the tolerance in percent. Every scenario reports
+ * the median of several runs, and replay scenarios check that BIRD ends up
+ * with the ROAs of the trace. Each run also measures the speed of the host in a metric
+ * starting with "host_": the round trip rate of a socket pair for the replay
+ * scenarios, the rate of dependent memory reads for the others. Rates and
+ * latencies are compared with the baseline scaled by the ratio of this
+ * speed to the one in the baseline, so a busy or slower host does not fail
+ * them and a faster one does not hide a regression. Memory sizes are not
+ * scaled.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include "bulk.h"
+#include "replay.h"
+#include "util.h"
+#include "vrp.h"
+#include <rtrlib/rtrlib.h>
+
+// Maximum number of metrics per scenario.
+#define PERF_MAX_METRICS (8)
+// Maximum length of a baseline file line.
+#define PERF_LINE_SIZE (256)
+// Commands after which the mock drops the connection in "reconnect".
+#define PERF_RECONNECT_INTERVAL (10000)
+// Memory budget of the VRP store per IPv4 VRP.
+#define PERF_MAX_BYTES_PER_IPV4_VRP (16)
+// Absolute latency slack, keeps scheduler noise on tiny latencies from
+// failing the tests.
+#define PERF_LATENCY_SLACK_US (10)
+// Runs of a scenario, the median counts.
+#define PERF_RUNS (5)
+// Samples of the host speed, the fastest counts as the others were slowed
+// down by other load on the host.
+#define PERF_HOST_SAMPLES (5)
+// Round trips per sample of the speed of the host before a replay run.
+#define PERF_HOST_ROUNDTRIPS (4000)
+// Prefix of the metrics with the host speed the others are scaled with.
+#define PERF_HOST_PREFIX "host_"
+// Entries of the pointer chase measuring the memory speed of the host.
+#define PERF_HOST_READ_ENTRIES (1 << 23)
+// Dependent reads per sample of the memory speed of the host.
+#define PERF_HOST_READS (500000)
+// Maximum number of extra CLI arguments.
+#define PERF_MAX_CLI_ARGS (16)
+
+// Command line options.
+struct perf_options {
+    const char *scenario;
+    const char *cli;
+    const char *baseline;
+    double tolerance;
+    long count;
+    int write_baseline;
+    const char *cli_args[PERF_MAX_CLI_ARGS];
+    int cli_args_len;
+};
+
+// A measured value.
+struct perf_metric {
+    const char *name;
+    double value;
+};
+
+// Results of a scenario run.
+struct perf_result {
+    struct perf_metric metrics[PERF_MAX_METRICS];
+    int metrics_len;
+};
+
+// Runs a scenario once, returns 0 on success.
+typedef int (*perf_scenario_fp)(const struct perf_options *options,
+                                struct perf_result *result);
+
+// State of the mock BIRD control socket.
+struct perf_mock {
+    int socket;
+    char path[108];
+    long drop_interval;
+    long commands;
+    // Commands of all connections, complete lines only.
+    char *log;
+    size_t log_len;
+    size_t log_size;
+    int log_failed;
+    uint32_t *gaps;
+    long gaps_len;
+    uint32_t *window_gaps;
+    long window_gaps_len;
+    long gaps_size;
+    pthread_t thread;
+};
+
+// State of the pseudo random number generator.
+static uint64_t perf_random_state = 88172645463325252ULL;
+
+static uint64_t perf_random(void)
+{
+    perf_random_state ^= perf_random_state << 13;
+    perf_random_state ^= perf_random_state >> 7;
+    perf_random_state ^= perf_random_state << 17;
+    return perf_random_state;
+}
+
+static void perf_add_metric(struct perf_result *result, const char *name,
+                            double value)
+{
+    result->metrics[result->metrics_len].name = name;
+    result->metrics[result->metrics_len].value = value;
+    result->metrics_len++;
+}
+
+// Creates the i-th VRP of a synthetic set: 4 out of 5 are IPv4 /24s, the
+// others IPv6 /48s.
+static void perf_make_vrp(long i, struct pfx_record *record)
+{
+    memset(record, 0, sizeof (struct pfx_record));
+    record->asn = 64496 + (i % 50000);
+    if (i % 5 != 4) {
+        record->prefix.ver = LRTR_IPV4;
+        record->prefix.u.addr4.addr = (uint32_t) (0x01000000 + i * 256);
+        record->min_len = 24;
+        record->max_len = 24;
+    } else {
+        record->prefix.ver = LRTR_IPV6;
+        record->prefix.u.addr6.addr[0] = 0x20010000 | ((i >> 16) & 0xffff);
+        record->prefix.u.addr6.addr[1] = (i & 0xffff) << 16;
+        record->min_len = 48;
+        record->max_len = 48;
+    }
+}
+
+// Writes the update trace of a scenario and applies it to `expected`, the
+// ROAs BIRD must have in the end. Returns 0 on success.
+static int perf_write_trace(const char *path, const char *scenario,
+                            long count, struct vrp_store *expected)
+{
+    unsigned char buffer[REPLAY_RECORD_SIZE];
+    struct pfx_record record;
+    FILE *file = fopen(path, "wb");
+    if (!file)
+        return -1;
+    fwrite(REPLAY_MAGIC, 1, REPLAY_MAGIC_SIZE, file);
+    for (long i = 0; i < count; i++) {
+        int added = 1;
+        // Churn withdraws and re-announces random VRPs of the set. Like an
+        // RTR cache, it announces only absent VRPs and withdraws present
+        // ones.
+        if (strcmp(scenario, "churn") == 0) {
+            perf_make_vrp(perf_random() % count, &record);
+            added = vrp_store_find(expected, &record, NULL) != 1;
+        } else {
+            perf_make_vrp(i, &record);
+        }
+        replay_encode(buffer, 0, &record, added);
+        fwrite(buffer, 1, REPLAY_RECORD_SIZE, file);
+        if (added)
+            vrp_store_add(expected, &record, NULL);
+        else
+            vrp_store_remove(expected, &record);
+    }
+    return fclose(file);
+}
+
+// Appends what the mock read to its command log.
+static void perf_mock_log(struct perf_mock *mock, const char *buffer,
+                          size_t len)
+{
+    if (mock->log_len + len > mock->log_size) {
+        const size_t size = (mock->log_size + len) * 2;
+        char *log = realloc(mock->log, size);
+        if (!log) {
+            mock->log_failed = 1;
+            return;
+        }
+        mock->log = log;
+        mock->log_size = size;
+    }
+    memcpy(mock->log + mock->log_len, buffer, len);
+    mock->log_len += len;
+}
+
+// Answers every command with "0000", records the time between an answer and
+// the next command per command, i.e., how long each command waited, and per
+// read, i.e., per window of pipelined commands.
+static void *perf_mock_thread(void *arg)
+{
+    static const char greeting[] = "0001 BIRD perf mock ready.\n";
+    static const char ok[] = "0000 \n";
+    struct perf_mock *mock = arg;
+    char buffer[4096];
+    int client;
+    while ((client = accept(mock->socket, NULL, NULL)) >= 0) {
+        const size_t log_begin = mock->log_len;
+        long served = 0;
+        uint64_t answered = 0;
+        ssize_t n;
+        if (write(client, greeting, sizeof greeting - 1) < 0) {
+            close(client);
+            continue;
+        }
+        while ((n = read(client, buffer, sizeof buffer)) > 0) {
+            const uint64_t now = util_clock();
+            perf_mock_log(mock, buffer, n);
+            // All commands of the read waited since the last answer.
+            const uint64_t gap = answered ? now - answered : 0;
+            if (answered && memchr(buffer, '\n', n) &&
+                mock->window_gaps_len < mock->gaps_size)
+                mock->window_gaps[mock->window_gaps_len++] = gap;
+            for (char *c = memchr(buffer, '\n', n); c;
+                 c = memchr(c + 1, '\n', buffer + n - c - 1)) {
+                if (answered && mock->gaps_len < mock->gaps_size)
+                    mock->gaps[mock->gaps_len++] = gap;
+                mock->commands++;
+                served++;
+                if (write(client, ok, sizeof ok - 1) < 0)
+                    break;
+                answered = util_clock();
+            }
+            if (mock->drop_interval && served >= mock->drop_interval)
+                break;
+        }
+        close(client);
+        // A command cut off by the drop was never answered.
+        while (mock->log_len > log_begin &&
+               mock->log[mock->log_len - 1] != '\n')
+            mock->log_len--;
+    }
+    return NULL;
+}
+
+static int perf_mock_start(struct perf_mock *mock, const char *dir,
+                           long drop_interval, long gaps_size)
+{
+    struct sockaddr_un addr;
+    memset(mock, 0, sizeof (struct perf_mock));
+    snprintf(mock->path, sizeof mock->path, "%s/bird.ctl", dir);
+    mock->drop_interval = drop_interval;
+    mock->gaps = calloc(gaps_size, sizeof (uint32_t));
+    mock->window_gaps = calloc(gaps_size, sizeof (uint32_t));
+    mock->gaps_size = gaps_size;
+    mock->socket = socket(AF_UNIX, SOCK_STREAM, 0);
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, mock->path);
+    if (!mock->gaps || !mock->window_gaps || mock->socket < 0 ||
+        bind(mock->socket, (struct sockaddr *) &addr, sizeof addr) != 0 ||
+        listen(mock->socket, 1) != 0) {
+        perror("mock BIRD socket");
+        return -1;
+    }
+    return pthread_create(&mock->thread, NULL, perf_mock_thread, mock);
+}
+
+static void perf_mock_stop(struct perf_mock *mock)
+{
+    shutdown(mock->socket, SHUT_RDWR);
+    pthread_join(mock->thread, NULL);
+    close(mock->socket);
+    unlink(mock->path);
+    free(mock->log);
+    free(mock->gaps);
+    free(mock->window_gaps);
+}
+
+static int perf_compare_gaps(const void *a, const void *b)
+{
+    const uint32_t x = *(const uint32_t *) a;
+    const uint32_t y = *(const uint32_t *) b;
+    return x < y ? -1 : x > y;
+}
+
+// Measures the rate of command/answer round trips between two processes over
+// a Unix socket pair, the basic operation of the replay scenarios, or 0 on
+// failure.
+static double perf_host_roundtrips(void)
+{
+    static const char command[] = "add roa 192.0.2.0/24 max 24 as 64496\n";
+    static const char ok[] = "0000 \n";
+    char buffer[64];
+    int pair[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0)
+        return 0;
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(pair[0]);
+        while (read(pair[1], buffer, sizeof buffer) > 0 &&
+               write(pair[1], ok, sizeof ok - 1) > 0)
+            ;
+        _exit(0);
+    }
+    close(pair[1]);
+    double rate = 0;
+    for (int sample = 0; pid > 0 && sample < PERF_HOST_SAMPLES; sample++) {
+        const uint64_t begin = util_clock();
+        int i = 0;
+        for (; i < PERF_HOST_ROUNDTRIPS; i++) {
+            if (write(pair[0], command, sizeof command - 1) <= 0 ||
+                read(pair[0], buffer, sizeof buffer) <= 0)
+                break;
+        }
+        const uint64_t end = util_clock();
+        if (i < PERF_HOST_ROUNDTRIPS) {
+            rate = 0;
+            break;
+        }
+        if (i / ((end - begin + 1) / 1e6) > rate)
+            rate = i / ((end - begin + 1) / 1e6);
+    }
+    close(pair[0]);
+    if (pid > 0)
+        waitpid(pid, NULL, 0);
+    return rate;
+}
+
+// Measures the rate of dependent reads from memory, the basic operation of
+// the table lookups in the other scenarios, or 0 on failure.
+static double perf_host_reads(void)
+{
+    uint32_t *next = malloc(PERF_HOST_READ_ENTRIES * sizeof (uint32_t));
+    uint64_t state = 1;
+    uint32_t at = 0;
+    if (!next)
+        return 0;
+    // Sattolo's shuffle links all entries into a single cycle. It has its
+    // own generator, so the scenarios get the same random numbers.
+    for (uint32_t i = 0; i < PERF_HOST_READ_ENTRIES; i++)
+        next[i] = i;
+    for (uint32_t i = PERF_HOST_READ_ENTRIES - 1; i > 0; i--) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        const uint32_t j = (state >> 33) % i;
+        const uint32_t swap = next[i];
+        next[i] = next[j];
+        next[j] = swap;
+    }
+    double rate = 0;
+    for (int sample = 0; sample < PERF_HOST_SAMPLES; sample++) {
+        const uint64_t begin = util_clock();
+        for (long i = 0; i < PERF_HOST_READS; i++)
+            at = next[at];
+        const uint64_t end = util_clock();
+        if (PERF_HOST_READS / ((end - begin + 1) / 1e6) > rate)
+            rate = PERF_HOST_READS / ((end - begin + 1) / 1e6);
+    }
+    free(next);
+    // Using the end of the chase keeps it from being optimized away.
+    return at < PERF_HOST_READ_ENTRIES ? rate : 0;
+}
+
+// Applies the ROA commands in the log of the mock to `table`.
+static void perf_apply_commands(const struct perf_mock *mock,
+                                struct vrp_store *table)
+{
+    char line[PERF_LINE_SIZE];
+    char operation[16], address[INET6_ADDRSTRLEN];
+    unsigned int len, max_len, asn;
+    struct pfx_record record;
+    for (size_t begin = 0, end; begin < mock->log_len; begin = end + 1) {
+        end = begin;
+        while (mock->log[end] != '\n')
+            end++;
+        if (end - begin >= sizeof line)
+            continue;
+        memcpy(line, mock->log + begin, end - begin);
+        line[end - begin] = '\0';
+        memset(&record, 0, sizeof record);
+        if (sscanf(line, "%15s roa %45[^/]/%u max %u as %u", operation,
+                   address, &len, &max_len, &asn) != 5 ||
+            lrtr_ip_str_to_addr(address, &record.prefix) != 0)
+            continue;
+        record.min_len = len;
+        record.max_len = max_len;
+        record.asn = asn;
+        if (strcmp(operation, "add") == 0)
+            vrp_store_add(table, &record, NULL);
+        else if (strcmp(operation, "delete") == 0)
+            vrp_store_remove(table, &record);
+    }
+}
+
+// A table compared with the expected ROAs.
+struct perf_table_diff {
+    const struct vrp_store *table;
+    long missing;
+};
+
+static void perf_find_expected(const struct pfx_record *record, void *value,
+                               void *data)
+{
+    struct perf_table_diff *diff = data;
+    diff->missing += vrp_store_find(diff->table, record, NULL) != 1;
+}
+
+// Checks the ROAs BIRD ended up with against the expected ones, returns 0
+// if they are the same.
+static int perf_check_table(const struct perf_mock *mock,
+                            const struct vrp_store *expected)
+{
+    struct vrp_store table;
+    vrp_store_init(&table, 0);
+    perf_apply_commands(mock, &table);
+    struct perf_table_diff diff = { &table, 0 };
+    vrp_store_for_each(expected, perf_find_expected, &diff);
+    const long extra = (long) vrp_store_count(&table) -
+        ((long) vrp_store_count(expected) - diff.missing);
+    if (diff.missing || extra)
+        fprintf(stderr, "BIRD has %zu ROAs, %ld of the %zu expected missing "
+                "and %ld extra\n", vrp_store_count(&table), diff.missing,
+                vrp_store_count(expected), extra);
+    vrp_store_free(&table);
+    return diff.missing || extra ? -1 : 0;
+}
+
+// Replays a synthetic trace with the CLI against the mock BIRD.
+static int perf_run_replay(const struct perf_options *options,
+                           struct perf_result *result)
+{
+    char dir[] = "/tmp/bird-rtrlib-cli-perf.XXXXXX";
+    char trace[sizeof dir + 16];
+    struct perf_mock mock;
+    struct vrp_store expected;
+    int status;
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp");
+        return -1;
+    }
+    snprintf(trace, sizeof trace, "%s/updates.trc", dir);
+    vrp_store_init(&expected, 0);
+    if (perf_write_trace(trace, options->scenario, options->count,
+                         &expected) != 0) {
+        perror("trace");
+        vrp_store_free(&expected);
+        rmdir(dir);
+        return -1;
+    }
+    const double host_before = perf_host_roundtrips();
+    if (host_before == 0) {
+        perror("host round trips");
+        vrp_store_free(&expected);
+        unlink(trace);
+        rmdir(dir);
+        return -1;
+    }
+    const long drop = strcmp(options->scenario, "reconnect") == 0 ?
+        PERF_RECONNECT_INTERVAL : 0;
+    if (perf_mock_start(&mock, dir, drop, options->count) != 0) {
+        vrp_store_free(&expected);
+        unlink(trace);
+        rmdir(dir);
+        return -1;
+    }
+    const uint64_t begin = util_clock();
+    // Room for the terminating NULL.
+    const char *argv[8 + PERF_MAX_CLI_ARGS + 1] = {
+        options->cli, "-q", "-b", mock.path,
+        "--replay", trace, "--replay-speed", "0"
+    };
+    for (int i = 0; i < options->cli_args_len; i++)
+        argv[8 + i] = options->cli_args[i];
+    pid_t pid = fork();
+    if (pid == 0) {
+        execv(options->cli, (char **) argv);
+        perror("exec");
+        _exit(127);
+    }
+    if (pid < 0 || waitpid(pid, &status, 0) != pid ||
+        !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "%s failed\n", options->cli);
+        perf_mock_stop(&mock);
+        vrp_store_free(&expected);
+        unlink(trace);
+        rmdir(dir);
+        return -1;
+    }
+    const double seconds = (util_clock() - begin) / 1e6;
+    // The load of a shared host changes, so it is measured on both sides of
+    // every run.
+    const double host = (host_before + perf_host_roundtrips()) / 2;
+    const long commands = mock.commands;
+    const long gaps = mock.gaps_len;
+    const long window_gaps = mock.window_gaps_len;
+    qsort(mock.gaps, gaps, sizeof (uint32_t), perf_compare_gaps);
+    qsort(mock.window_gaps, window_gaps, sizeof (uint32_t), perf_compare_gaps);
+    // Updates the CLI got through, churn may be coalesced into fewer
+    // commands.
+    perf_add_metric(result, "updates_per_s", options->count / seconds);
+    perf_add_metric(result, "p50_us", gaps ? mock.gaps[gaps / 2] : 0);
+    perf_add_metric(result, "p99_us", gaps ? mock.gaps[gaps * 99 / 100] : 0);
+    perf_add_metric(result, "window_p50_us",
+                    window_gaps ? mock.window_gaps[window_gaps / 2] : 0);
+    perf_add_metric(result, "window_p99_us",
+                    window_gaps ? mock.window_gaps[window_gaps * 99 / 100] :
+                    0);
+    perf_add_metric(result, "host_roundtrips_per_s", host);
+    fprintf(stderr, "BIRD received %ld commands for %ld updates\n",
+            commands, options->count);
+    // Whatever was coalesced or resent, BIRD must end up with the ROAs of
+    // the trace.
+    const int ret = mock.log_failed ? -1 : perf_check_table(&mock, &expected);
+    if (mock.log_failed)
+        fprintf(stderr, "Out of memory for the BIRD command log\n");
+    perf_mock_stop(&mock);
+    vrp_store_free(&expected);
+    unlink(trace);
+    rmdir(dir);
+    return ret;
+}
+
+static int perf_compare_values(const void *a, const void *b)
+{
+    const double x = *(const double *) a;
+    const double y = *(const double *) b;
+    return x < y ? -1 : x > y;
+}
+
+// Runs a scenario several times and keeps the median of every metric, so
+// neither a single slow nor a single lucky run counts.
+static int perf_run_median(const struct perf_options *options,
+                           perf_scenario_fp scenario,
+                           struct perf_result *result)
+{
+    struct perf_result runs[PERF_RUNS];
+    double values[PERF_RUNS];
+    memset(runs, 0, sizeof runs);
+    for (int i = 0; i < PERF_RUNS; i++) {
+        if (scenario(options, &runs[i]) != 0)
+            return -1;
+    }
+    *result = runs[0];
+    for (int m = 0; m < result->metrics_len; m++) {
+        for (int i = 0; i < PERF_RUNS; i++)
+            values[i] = runs[i].metrics[m].value;
+        qsort(values, PERF_RUNS, sizeof (double), perf_compare_values);
+        result->metrics[m].value = values[PERF_RUNS / 2];
+    }
+    return 0;
+}
+
+// Validates synthetic routes against half as many VRPs.
+static int perf_run_validate(const struct perf_options *options,
+                             struct perf_result *result)
+{
+    struct pfx_table table;
+    struct pfx_record record;
+    struct bulk_stats stats;
+    char *input = 0;
+    size_t input_len = 0;
+    char address[INET6_ADDRSTRLEN];
+    const double host = perf_host_reads();
+    if (host == 0)
+        return -1;
+    pfx_table_init(&table, NULL);
+    for (long i = 0; i < options->count / 2; i++) {
+        perf_make_vrp(i, &record);
+        pfx_table_add(&table, &record);
+    }
+    // Routes are VRP prefixes with matching, wrong and unknown origins.
+    FILE *in = open_memstream(&input, &input_len);
+    for (long i = 0; i < options->count; i++) {
+        perf_make_vrp(perf_random() % options->count, &record);
+        lrtr_ip_addr_to_str(&record.prefix, address, sizeof address);
+        fprintf(in, "%s/%u %u\n", address, record.min_len,
+                record.asn + (i % 3 == 0));
+    }
+    fclose(in);
+    in = fmemopen(input, input_len, "r");
+    FILE *out = fopen("/dev/null", "w");
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    struct pfx_table *tables[] = { &table };
+    int ret = bulk_validate(tables, 1, in, out, cpus > 0 ? cpus : 1, &stats);
+    fclose(in);
+    fclose(out);
+    free(input);
+    pfx_table_free(&table);
+    if (ret != 0 || stats.lookups != (unsigned long) options->count)
+        return -1;
+    perf_add_metric(result, "lookups_per_s_per_thread",
+                    stats.lookups / stats.seconds / stats.threads);
+    perf_add_metric(result, "host_reads_per_s",
+                    (host + perf_host_reads()) / 2);
+    return 0;
+}
+
+// Counts VRPs visited in order, fails on order violations.
+struct perf_order {
+    struct pfx_record last;
+    long count;
+    int errors;
+};
+
+static void perf_check_order(const struct pfx_record *record, void *value,
+                             void *data)
+{
+    struct perf_order *order = data;
+    const struct pfx_record *last = &order->last;
+    if (order->count > 0 && last->prefix.ver == record->prefix.ver) {
+        int cmp = 0;
+        if (record->prefix.ver == LRTR_IPV4) {
+            if (record->prefix.u.addr4.addr != last->prefix.u.addr4.addr)
+                cmp = record->prefix.u.addr4.addr <
+                    last->prefix.u.addr4.addr ? -1 : 1;
+        } else {
+            for (int i = 0; i < 4 && cmp == 0; i++)
+                if (record->prefix.u.addr6.addr[i] !=
+                    last->prefix.u.addr6.addr[i])
+                    cmp = record->prefix.u.addr6.addr[i] <
+                        last->prefix.u.addr6.addr[i] ? -1 : 1;
+        }
+        order->errors += cmp < 0;
+    }
+    order->errors += order->count > 0 && last->prefix.ver == LRTR_IPV6 &&
+        record->prefix.ver == LRTR_IPV4;
+    order->last = *record;
+    order->count++;
+}
+
+// Measures the VRP store and checks its consistency on the way.
+static int perf_run_vrp_store(const struct perf_options *options,
+                              struct perf_result *result)
+{
+    struct vrp_store store;
+    struct pfx_record record;
+    struct perf_order order;
+    long errors = 0;
+    long ipv4 = 0;
+    const double host = perf_host_reads();
+    if (host == 0)
+        return -1;
+    // Memory of an IPv4 only set.
+    vrp_store_init(&store, 0);
+    for (long i = 0; i < options->count; i++) {
+        perf_make_vrp(i, &record);
+        if (record.prefix.ver == LRTR_IPV4) {
+            errors += vrp_store_add(&store, &record, NULL) != 1;
+            ipv4++;
+        }
+    }
+    const double ipv4_bytes = (double) vrp_store_memory(&store) / ipv4;
+    perf_add_metric(result, "bytes_per_ipv4_vrp", ipv4_bytes);
+    if (ipv4_bytes >= PERF_MAX_BYTES_PER_IPV4_VRP) {
+        fprintf(stderr, "VRP store needs %.1f bytes per IPv4 VRP\n",
+                ipv4_bytes);
+        errors++;
+    }
+    vrp_store_free(&store);
+    // Rates of a mixed set.
+    vrp_store_init(&store, 0);
+    uint64_t begin = util_clock();
+    for (long i = 0; i < options->count; i++) {
+        perf_make_vrp(i, &record);
+        errors += vrp_store_add(&store, &record, NULL) != 1;
+    }
+    perf_add_metric(result, "inserts_per_s",
+                    options->count / ((util_clock() - begin + 1) / 1e6));
+    perf_add_metric(result, "bytes_per_vrp",
+                    (double) vrp_store_memory(&store) / options->count);
+    begin = util_clock();
+    for (long i = 0; i < options->count; i++) {
+        perf_make_vrp(perf_random() % options->count, &record);
+        errors += vrp_store_find(&store, &record, NULL) != 1;
+    }
+    perf_add_metric(result, "lookups_per_s",
+                    options->count / ((util_clock() - begin + 1) / 1e6));
+    // Remove every other VRP and check what is left.
+    for (long i = 0; i < options->count; i += 2) {
+        perf_make_vrp(i, &record);
+        errors += vrp_store_remove(&store, &record) != 1;
+    }
+    for (long i = 0; i < options->count; i++) {
+        perf_make_vrp(i, &record);
+        errors += vrp_store_find(&store, &record, NULL) != i % 2;
+    }
+    memset(&order, 0, sizeof order);
+    errors += vrp_store_for_each_sorted(&store, perf_check_order, &order);
+    errors += order.errors + (order.count != options->count / 2);
+    vrp_store_free(&store);
+    perf_add_metric(result, "host_reads_per_s",
+                    (host + perf_host_reads()) / 2);
+    if (errors)
+        fprintf(stderr, "VRP store: %ld errors\n", errors);
+    return errors ? -1 : 0;
+}
+
+// Replaces the metrics of the scenario in the baseline file.
+static int perf_write_baseline(const struct perf_options *options,
+                               const struct perf_result *result)
+{
+    char line[PERF_LINE_SIZE];
+    char *kept = 0;
+    size_t kept_len = 0;
+    const size_t scenario_len = strlen(options->scenario);
+    FILE *out = open_memstream(&kept, &kept_len);
+    FILE *in = fopen(options->baseline, "r");
+    while (in && fgets(line, sizeof line, in))
+        if (strncmp(line, options->scenario, scenario_len) != 0 ||
+            line[scenario_len] != ' ')
+            fputs(line, out);
+    if (in)
+        fclose(in);
+    for (int i = 0; i < result->metrics_len; i++)
+        fprintf(out, "%s %s %.1f\n", options->scenario,
+                result->metrics[i].name, result->metrics[i].value);
+    fclose(out);
+    FILE *file = fopen(options->baseline, "w");
+    int ret = file && fputs(kept, file) >= 0 ? 0 : -1;
+    if (file && fclose(file) != 0)
+        ret = -1;
+    free(kept);
+    return ret;
+}
+
+// Returns the host speed metric of the results, or NULL if there is none.
+static const struct perf_metric *perf_host_metric(
+    const struct perf_result *result)
+{
+    for (int i = 0; i < result->metrics_len; i++)
+        if (strncmp(result->metrics[i].name, PERF_HOST_PREFIX,
+                    strlen(PERF_HOST_PREFIX)) == 0)
+            return &result->metrics[i];
+    return NULL;
+}
+
+// Reads the host speed metric of the scenario from the baseline, 0 if there
+// is none.
+static double perf_baseline_host(const struct perf_options *options,
+                                 const char *name)
+{
+    char line[PERF_LINE_SIZE];
+    char scenario[64], metric[64];
+    double value, host = 0;
+    FILE *in = fopen(options->baseline, "r");
+    while (in && fgets(line, sizeof line, in)) {
+        if (line[0] != '#' &&
+            sscanf(line, "%63s %63s %lf", scenario, metric, &value) == 3 &&
+            strcmp(scenario, options->scenario) == 0 &&
+            strcmp(metric, name) == 0)
+            host = value;
+    }
+    if (in)
+        fclose(in);
+    return host;
+}
+
+// Compares the results with the baseline, returns the number of regressions.
+static int perf_check_baseline(const struct perf_options *options,
+                               const struct perf_result *result)
+{
+    char line[PERF_LINE_SIZE];
+    char scenario[64], metric[64];
+    double expected;
+    int regressions = 0;
+    FILE *in = fopen(options->baseline, "r");
+    if (!in) {
+        fprintf(stderr, "No baseline %s, nothing to compare\n",
+                options->baseline);
+        return 0;
+    }
+    // Rates and latencies scale with the speed of the host relative to the
+    // baseline.
+    const struct perf_metric *host = perf_host_metric(result);
+    const double baseline_host = host ?
+        perf_baseline_host(options, host->name) : 0;
+    const double scale = baseline_host > 0 && host->value > 0 ?
+        host->value / baseline_host : 1;
+    if (scale != 1)
+        printf("%s: host at %.0f%% of the baseline host, limits scaled\n",
+               options->scenario, scale * 100);
+    while (fgets(line, sizeof line, in)) {
+        if (line[0] == '#' ||
+            sscanf(line, "%63s %63s %lf", scenario, metric, &expected) != 3 ||
+            strcmp(scenario, options->scenario) != 0 ||
+            strncmp(metric, PERF_HOST_PREFIX, strlen(PERF_HOST_PREFIX)) == 0)
+            continue;
+        for (int i = 0; i < result->metrics_len; i++) {
+            const struct perf_metric *m = &result->metrics[i];
+            if (strcmp(m->name, metric) != 0)
+                continue;
+            const size_t len = strlen(metric);
+            const int latency = len > 3 &&
+                strcmp(metric + len - 3, "_us") == 0;
+            const int lower_is_better = latency ||
+                strncmp(metric, "bytes_", 6) == 0;
+            if (!lower_is_better)
+                expected *= scale;
+            else if (latency)
+                expected /= scale;
+            const double limit = lower_is_better ?
+                expected * (1 + options->tolerance / 100) +
+                (latency ? PERF_LATENCY_SLACK_US : 0) :
+                expected * (1 - options->tolerance / 100);
+            const int regressed = lower_is_better ?
+                m->value > limit : m->value < limit;
+            printf("%s %s: %.1f, baseline %.1f, limit %.1f: %s\n",
+                   scenario, metric, m->value, expected, limit,
+                   regressed ? "REGRESSION" : "ok");
+            regressions += regressed;
+        }
+    }
+    fclose(in);
+    return regressions;
+}
+
+static void perf_usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s --scenario full-load|churn|reconnect|validate|vrp-store "
+            "--baseline <file> [--cli <bird-rtrlib-cli>] [--tolerance <%%>] "
+            "[--count <n>] [--cli-arg <arg>]... [--write-baseline]\n", name);
+}
+
+int main(int argc, char *argv[])
+{
+    struct perf_options options = { .tolerance = 25 };
+    struct perf_result result;
+    int ret;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--write-baseline") == 0)
+            options.write_baseline = 1;
+        else if (i + 1 >= argc)
+            break;
+        else if (strcmp(argv[i], "--scenario") == 0)
+            options.scenario = argv[++i];
+        else if (strcmp(argv[i], "--cli") == 0)
+            options.cli = argv[++i];
+        else if (strcmp(argv[i], "--baseline") == 0)
+            options.baseline = argv[++i];
+        else if (strcmp(argv[i], "--tolerance") == 0)
+            options.tolerance = strtod(argv[++i], NULL);
+        else if (strcmp(argv[i], "--count") == 0)
+            options.count = strtol(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--cli-arg") == 0 &&
+                 options.cli_args_len < PERF_MAX_CLI_ARGS)
+            options.cli_args[options.cli_args_len++] = argv[++i];
+    }
+    if (!options.scenario || !options.baseline) {
+        perf_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    memset(&result, 0, sizeof result);
+    signal(SIGPIPE, SIG_IGN);
+    if (strcmp(options.scenario, "validate") == 0) {
+        if (!options.count)
+            options.count = 1000000;
+        ret = perf_run_median(&options, perf_run_validate, &result);
+    } else if (strcmp(options.scenario, "vrp-store") == 0) {
+        if (!options.count)
+            options.count = 1000000;
+        ret = perf_run_median(&options, perf_run_vrp_store, &result);
+    } else if (options.cli &&
+               (strcmp(options.scenario, "full-load") == 0 ||
+                strcmp(options.scenario, "churn") == 0 ||
+                strcmp(options.scenario, "reconnect") == 0)) {
+        if (!options.count)
+            options.count = 200000;
+        ret = perf_run_median(&options, perf_run_replay, &result);
+    } else {
+        perf_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (ret != 0) {
+        fprintf(stderr, "Scenario %s failed\n", options.scenario);
+        return EXIT_FAILURE;
+    }
+    for (int i = 0; i < result.metrics_len; i++)
+        printf("%s %s %.1f\n", options.scenario, result.metrics[i].name,
+               result.metrics[i].value);
+    if (options.write_baseline)
+        return perf_write_baseline(&options, &result) == 0 ?
+            EXIT_SUCCESS : EXIT_FAILURE;
+    return perf_check_baseline(&options, &result) == 0 ?
+        EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,81 @@
+# Steps of the profile-guided optimization, run with cmake -P by the targets
+# of the top-level CMakeLists.txt:
+#   PGO_STEP=train   builds an instrumented binary in pgo-generate, runs the
+#                    replay benchmarks with it and keeps the profiles
+#   PGO_STEP=report  builds a plain binary in pgo-reference and compares its
+#                    replay throughput with the one of PGO_CLI
+set(PGO_SCENARIOS full-load churn reconnect)
+# Rounds per build when reporting.
+set(PGO_ROUNDS 3)
+
+# Configures and builds a sub-build of the sources.
+function(pgo_build dir)
+    execute_process(COMMAND ${CMAKE_COMMAND} -S ${PGO_SOURCE_DIR} -B ${dir}
+            -DCMAKE_BUILD_TYPE=${PGO_BUILD_TYPE}
+            -DCMAKE_C_COMPILER=${PGO_C_COMPILER}
+            -DRTRLIB_INCLUDE=${RTRLIB_INCLUDE}
+            -DRTRLIB_LIBRARY=${RTRLIB_LIBRARY}
+            -DBUILD_PERF_TESTS=ON -DENABLE_PGO=OFF ${ARGN}
+        OUTPUT_QUIET ERROR_VARIABLE log RESULT_VARIABLE ret)
+    if(NOT ret EQUAL 0)
+        message(FATAL_ERROR "Configuring ${dir} failed:\n${log}")
+    endif()
+    execute_process(COMMAND ${CMAKE_COMMAND} --build ${dir}
+        OUTPUT_VARIABLE log ERROR_VARIABLE log RESULT_VARIABLE ret)
+    if(NOT ret EQUAL 0)
+        message(FATAL_ERROR "Building ${dir} failed:\n${log}")
+    endif()
+endfunction()
+
+# Runs the replay scenarios with the perf driver of a sub-build and writes
+# the metrics to a baseline file.
+function(pgo_run dir cli baseline)
+    file(REMOVE ${baseline})
+    foreach(scenario ${PGO_SCENARIOS})
+        execute_process(COMMAND ${dir}/bench/perf-driver --scenario ${scenario}
+                --cli ${cli} --baseline ${baseline} --write-baseline
+            OUTPUT_QUIET ERROR_VARIABLE log RESULT_VARIABLE ret)
+        if(NOT ret EQUAL 0)
+            message(FATAL_ERROR "Scenario ${scenario} failed with ${cli}:\n${log}")
+        endif()
+    endforeach()
+endfunction()
+
+if(PGO_STEP STREQUAL "train")
+    set(dir ${PGO_BINARY_DIR}/pgo-generate)
+    file(REMOVE_RECURSE ${PGO_PROFILE_DIR})
+    pgo_build(${dir} -DPGO_PHASE=generate -DPGO_PROFILE_DIR=${PGO_PROFILE_DIR})
+    pgo_run(${dir} ${dir}/bird-rtrlib-cli ${dir}/training.txt)
+    file(WRITE ${PGO_PROFILE_DIR}/profile.stamp "")
+elseif(PGO_STEP STREQUAL "report")
+    set(dir ${PGO_BINARY_DIR}/pgo-reference)
+    pgo_build(${dir})
+    message("Replay throughput without and with PGO and LTO:")
+    foreach(scenario ${PGO_SCENARIOS})
+        # Alternate the builds and keep the best round of each against noise.
+        set(best_before 0)
+        set(best_after 0)
+        foreach(round RANGE 1 ${PGO_ROUNDS})
+            foreach(build before after)
+                if(build STREQUAL "before")
+                    set(cli ${dir}/bird-rtrlib-cli)
+                else()
+                    set(cli ${PGO_CLI})
+                endif()
+                set(PGO_SCENARIOS ${scenario})
+                pgo_run(${dir} ${cli} ${dir}/${build}.txt)
+                file(STRINGS ${dir}/${build}.txt lines
+                    REGEX "^${scenario} updates_per_s ")
+                string(REGEX MATCH "[0-9]+" value "${lines}")
+                if(value GREATER best_${build})
+                    set(best_${build} ${value})
+                endif()
+            endforeach()
+        endforeach()
+        math(EXPR change "(${best_after} - ${best_before}) * 100 / ${best_before}")
+        message("  ${scenario} updates_per_s: ${best_before} -> ${best_after} "
+            "(${change}%)")
+    endforeach()
+else()
+    message(FATAL_ERROR "Unknown PGO_STEP ${PGO_STEP}")
+endif()
@@ -20,40 +20,64 @@
  */
 
 #include <errno.h>
+#include <pthread.h>
 #include <signal.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <syslog.h>
+#include <time.h>
 #include <netinet/in.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 
+#include "config.h" // Defines bool, so it must precede rtrlib.
 #include "bird.h"
+#include "bulk.h"
+#include "cache.h"
 #include "cli.h"
-#include "config.h"
+#include "notify.h"
+#include "query.h"
+#include "replay.h"
 #include "rtr.h"
+#include "trace.h"
+#include "union.h"
+#include "util.h"
+#include "vrp.h"
+#include "writer.h"
 #include <rtrlib/rtrlib.h>
 
 #define CMD_EXIT "exit"
-#define BIRD_RSP_SIZE  (200)
-// Socket to BIRD.
-static int bird_socket = -1;
-// Buffer for BIRD commands.
-static char *bird_command = 0;
-// Length of buffer for BIRD commands.
-static size_t bird_command_length = -1;
-// "add roa" BIRD command "table" part. Defaults to an empty string and becomes
-// "table " + config->bird_roa_table if provided.
-static char *bird_add_roa_table_arg = "";
+#define CMD_TRACE "trace"
+// Seconds between status notifications to the service manager.
+#define NOTIFY_STATUS_INTERVAL (5)
+
+// Writers for all BIRD control sockets.
+static struct bird_writer bird_writers[CONFIG_MAX_BIRD_SOCKETS];
+// Merged ROAs of all caches, fed to the BIRD writers.
+static struct roa_union roa_union;
+// RTR cache sessions, none when replaying.
+static struct rtr_cache rtr_caches[CONFIG_MAX_RTR_SERVERS];
+static size_t rtr_caches_len = 0;
+// Thread applying the state of sessions down for longer than the expiry.
+static pthread_t rtr_expiry_thread;
+static pthread_mutex_t rtr_expiry_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t rtr_expiry_cond = PTHREAD_COND_INITIALIZER;
+static int rtr_expiry_started = 0;
+static int rtr_expiry_stop = 0;
+// Prefix tables of the caches, answering validation queries.
+static struct pfx_table *pfx_tables[CONFIG_MAX_RTR_SERVERS];
 // Main configuration.
 static struct config config;
 // for daemon loop
 static int time_to_die = 0;
 // fopr pidfile
 static int pid_fd = -1;
+// Thread writing the trace file on SIGUSR1.
+static pthread_t trace_thread;
+static int trace_thread_started = 0;
 
 /**
  * Handle SIGPIPE on bird_socket, write error log entry
@@ -100,151 +124,515 @@ void cleanup(void)
 }
 
 /**
- * Frees memory allocated with the " table <bird_roa_table>" clause for the
- * "add roa" BIRD command.
+ * Initializes the application prerequisites.
+ */
+void init(void)
+{
+    openlog(NULL, LOG_PERROR | LOG_CONS | LOG_PID, LOG_DAEMON);
+}
+
+/**
+ * Callback function for RTRLib that receives PFX records of a cache and
+ * applies them to the ROA union of its session.
+ * @param table
+ * @param record
+ * @param added
  */
-void cleanup_bird_add_roa_table_arg(void)
+static void pfx_update_callback(struct pfx_table *table,
+                                const struct pfx_record record,
+                                const bool added)
 {
-    // free buffer only, if not empty - i.e., mem was malloc'd
-    if (strcmp(bird_add_roa_table_arg, "") != 0)
-        free(bird_add_roa_table_arg);
+    struct rtr_cache *cache = rtr_cache_of(record.socket);
+    // Record the update as received.
+    record_update(&record, added);
+    // Nothing to do without BIRD, i.e., in bulk validation mode.
+    if (cache->roa_union->writers_len == 0)
+        return;
+    // The first update ends the wait for data and starts the initial sync.
+    trace_phase_end(TRACE_PHASE_FIRST_PDU);
+    trace_phase_begin(TRACE_PHASE_INITIAL_SYNC);
+    trace_phase_begin(TRACE_PHASE_BIRD_LOAD);
+    rtr_cache_update(cache, &record, added);
 }
 
 /**
- * Frees memory allocated with the BIRD command buffer.
+ * Sets up a writer for every BIRD control socket, feeding them from the ROA
+ * union unless replaying. Returns 0 on success or -1 on failure.
+ * @param replay
+ * @return
  */
-void cleanup_bird_command(void)
+static int init_bird_writers(int replay)
 {
-    if (bird_command) {
-        free(bird_command);
-        bird_command = 0;
-        bird_command_length = -1;
+    for (unsigned int i = 0; i < config.bird_sockets; i++) {
+        struct bird_writer *writer = &bird_writers[i];
+        if (bird_writer_init(writer, config.bird_socket_path[i],
+                             config.bird_roa_table,
+                             replay ? NULL : roa_union_load,
+                             &roa_union) != 0)
+            return -1;
+        writer->sort_threshold = config.sort_threshold;
+        writer->window_min = config.bird_window_min;
+        writer->window_max = config.bird_window_max;
+        writer->quiet = config.quiet;
+        // Replayed updates are not kept, so there is nothing to audit.
+        if (!replay) {
+            writer->expect = roa_union_expect;
+            writer->audit_interval = config.audit_interval;
+        }
+        roa_union.writers_len++;
     }
+    return 0;
 }
 
 /**
- * Initializes the application prerequisites.
+ * Starts all BIRD writers. Returns 0 on success or -1 on failure.
+ * @return
  */
-void init(void)
+static int start_bird_writers(void)
 {
-    openlog(NULL, LOG_PERROR | LOG_CONS | LOG_PID, LOG_DAEMON);
+    for (size_t i = 0; i < roa_union.writers_len; i++) {
+        if (bird_writer_start(&bird_writers[i]) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+/**
+ * Stops and frees all BIRD writers.
+ */
+static void free_bird_writers(void)
+{
+    for (size_t i = 0; i < roa_union.writers_len; i++) {
+        bird_writer_stop(&bird_writers[i]);
+        bird_writer_free(&bird_writers[i]);
+    }
+    roa_union.writers_len = 0;
 }
 
 /**
- * Creates and populates the "add roa" command's "table" argument buffer.
- * @param bird_roa_table
+ * Writes the metrics of the ROA union and the BIRD writers for the stats
+ * command. Returns the number of characters written or -1 if `out` is too
+ * small.
+ * @param out
+ * @param out_len
+ * @param data
+ * @return
  */
-void init_bird_add_roa_table_arg(char *bird_roa_table)
+static int write_stats(char *out, size_t out_len, void *data)
 {
-    // Size of the buffer (" table " + <roa_table> + \0).
-    const size_t length = (8 + strlen(bird_roa_table)) * sizeof (char);
-    // Allocate buffer.
-    bird_add_roa_table_arg = malloc(length);
-    // Populate buffer.
-    snprintf(bird_add_roa_table_arg, length, " table %s", bird_roa_table);
+    struct roa_union *roa_union = data;
+    struct bird_writer_stats stats;
+    size_t written = 0;
+    pthread_mutex_lock(&roa_union->mutex);
+    const size_t roas = vrp_store_count(&roa_union->store);
+    const struct damp_stats damp = roa_union->damp.stats;
+    pthread_mutex_unlock(&roa_union->mutex);
+    int n = snprintf(out, out_len, "roas %zu\n", roas);
+    if (n < 0 || (size_t) n >= out_len)
+        return -1;
+    written = n;
+    if (roa_union->damp.half_life) {
+        n = snprintf(out + written, out_len - written,
+                     "damp_flaps %lu\ndamp_held %lu\ndamp_released %lu\n"
+                     "damp_suppressed %zu\ndamp_tracked %zu\n", damp.flaps,
+                     damp.held, damp.released, damp.suppressed, damp.tracked);
+        if (n < 0 || (size_t) n >= out_len - written)
+            return -1;
+        written += n;
+    }
+    for (size_t i = 0; i < roa_union->writers_len; i++) {
+        struct bird_writer *writer = &roa_union->writers[i];
+        bird_writer_get_stats(writer, &stats);
+        n = snprintf(out + written, out_len - written,
+                     "bird_sent{socket=\"%1$s\"} %8$lu\n"
+                     "bird_queued{socket=\"%1$s\"} %9$zu\n"
+                     "bird_window{socket=\"%1$s\"} %10$u\n"
+                     "bird_window_latency_us{socket=\"%1$s\"} %11$llu\n"
+                     "bird_window_decreases{socket=\"%1$s\"} %12$lu\n"
+                     "bird_audit_chunks{socket=\"%1$s\"} %2$lu\n"
+                     "bird_audit_discarded{socket=\"%1$s\"} %3$lu\n"
+                     "bird_audit_missing{socket=\"%1$s\"} %4$lu\n"
+                     "bird_audit_extra{socket=\"%1$s\"} %5$lu\n"
+                     "bird_audit_foreign{socket=\"%1$s\"} %13$lu\n"
+                     "bird_audit_cycles{socket=\"%1$s\"} %6$lu\n"
+                     "bird_audit_cycle_seconds{socket=\"%1$s\"} %7$.3f\n",
+                     writer->socket_path, stats.audit_chunks,
+                     stats.audit_discarded, stats.audit_missing,
+                     stats.audit_extra, stats.audit_cycles,
+                     stats.audit_cycle_seconds, stats.sent, stats.queued,
+                     stats.window,
+                     (unsigned long long) stats.window_latency,
+                     stats.window_decreases, stats.audit_foreign);
+        if (n < 0 || (size_t) n >= out_len - written)
+            return -1;
+        written += n;
+    }
+    return written;
 }
 
 /**
- * Creates the buffer for the "add roa" command.
+ * Thread applying the state of sessions held back for longer than the
+ * expiry interval, once per second. RTRlib has dropped their expired data
+ * by then or does so later, so it is applied again every refresh interval
+ * until the session is established again. This does not depend on a status
+ * callback, which a quiet session may never get.
+ * @param arg
+ * @return
  */
-void init_bird_command(void)
+static void *rtr_expiry_thread_fp(void *arg)
 {
-    // Size of the buffer ("add roa " + <addr> + "/" + <minlen> + " max " +
-    // <maxlen> + " as " + <asnum> + <bird_add_roa_table_cmd> + \0)
-    bird_command_length = (
-        8 + // "add roa "
-        39 + // maxlength of IPv6 address
-        1 + // "/"
-        3 + // minimum length, "0" .. "128"
-        5 + // " max "
-        3 + // maximum length, "0" .. "128"
-        4 + // " as "
-        10 + // asnum, "0" .. "2^32 - 1" (max 10 chars)
-        strlen(bird_add_roa_table_arg) + // length of fixed " table " + <table>
-        1 // \0
-    ) * sizeof (char);
-    // Allocate buffer.
-    bird_command = malloc(bird_command_length);
+    pthread_mutex_lock(&rtr_expiry_mutex);
+    while (!rtr_expiry_stop) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += 1;
+        pthread_cond_timedwait(&rtr_expiry_cond, &rtr_expiry_mutex,
+                               &deadline);
+        for (size_t i = 0; i < rtr_caches_len && !rtr_expiry_stop; i++)
+            rtr_cache_expire(&rtr_caches[i], time(NULL));
+    }
+    pthread_mutex_unlock(&rtr_expiry_mutex);
+    return NULL;
 }
 
 /**
- * Callback function for RTRLib that receives PFX records, translates them to
- * BIRD `add roa` commands, sends them to the BIRD server and fetches the
- * answer.
- * @param table
+ * Starts applying the state of expired sessions. Returns 0 on success or -1
+ * on failure.
+ * @return
+ */
+static int start_rtr_expiry(void)
+{
+    if (pthread_create(&rtr_expiry_thread, NULL, rtr_expiry_thread_fp,
+                       NULL) != 0)
+        return -1;
+    rtr_expiry_started = 1;
+    return 0;
+}
+
+/**
+ * Stops applying the state of expired sessions. Must be called before the
+ * sessions are freed.
+ */
+static void stop_rtr_expiry(void)
+{
+    if (!rtr_expiry_started)
+        return;
+    pthread_mutex_lock(&rtr_expiry_mutex);
+    rtr_expiry_stop = 1;
+    pthread_cond_signal(&rtr_expiry_cond);
+    pthread_mutex_unlock(&rtr_expiry_mutex);
+    pthread_join(rtr_expiry_thread, NULL);
+    rtr_expiry_started = 0;
+}
+
+/**
+ * Thread writing the trace file whenever SIGUSR1 arrives, so the request is
+ * served at once, whatever the main loop is waiting for.
+ * @param arg
+ * @return
+ */
+static void *trace_signal_thread(void *arg)
+{
+    const sigset_t *signals = arg;
+    int signum;
+    while (sigwait(signals, &signum) == 0) {
+        // Not cancelled while holding the tracer.
+        pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+        trace_write();
+        pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+    }
+    return NULL;
+}
+
+/**
+ * Blocks SIGUSR1 in the calling thread and all threads it starts later, and
+ * accepts it in a thread writing the trace file if tracing is enabled. Must
+ * be called before any other thread is started. Returns 0 on success or -1
+ * on failure.
+ * @return
+ */
+static int start_trace_signal(void)
+{
+    static sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGUSR1);
+    if (pthread_sigmask(SIG_BLOCK, &signals, NULL) != 0)
+        return -1;
+    if (!config.trace_file)
+        return 0;
+    if (pthread_create(&trace_thread, NULL, trace_signal_thread,
+                       &signals) != 0)
+        return -1;
+    trace_thread_started = 1;
+    return 0;
+}
+
+/**
+ * Stops writing the trace file on SIGUSR1.
+ */
+static void stop_trace_signal(void)
+{
+    if (!trace_thread_started)
+        return;
+    // Wakes up the sigwait() in the thread.
+    pthread_cancel(trace_thread);
+    pthread_join(trace_thread, NULL);
+    trace_thread_started = 0;
+}
+
+/**
+ * Feeds a replayed update into the BIRD update path.
  * @param record
  * @param added
+ * @param data
  */
-static void pfx_update_callback(struct pfx_table *table,
-                                const struct pfx_record record,
-                                const bool added)
+static void replay_callback(const struct pfx_record *record, int added,
+                            void *data)
 {
-    // IP address buffer.
-    static char ip_addr_str[INET6_ADDRSTRLEN];
-    // Buffer for BIRD response.
-    static char bird_response[BIRD_RSP_SIZE];
-    // Fetch IP address as string.
-    lrtr_ip_addr_to_str(&(record.prefix), ip_addr_str, sizeof(ip_addr_str));
-    // Crude way of filtering out sending Bird the wrong kind of updates
-    if (config.ip_version)
-    {
-        int prefix_allowed = 0;
-	// Is this an IPv4 prefix?
-        if ((strchr(ip_addr_str,'.') != NULL) && (strchr(config.ip_version, '4') != NULL) )  
-	    prefix_allowed++;
-        if ((strchr(ip_addr_str,':') != NULL) && (strchr(config.ip_version, '6') != NULL) )  
-            prefix_allowed++;
-        if (prefix_allowed == 0) 
-    	    return;
-    }
-    // Write BIRD command to buffer.
-    if (
-        snprintf(
-            bird_command,
-            bird_command_length,
-            "%s roa %s/%u max %u as %u%s\n",
-            added ? "add" : "delete",
-            ip_addr_str,
-            record.min_len,
-            record.max_len,
-            record.asn,
-            bird_add_roa_table_arg
-        )
-        >= bird_command_length
-    ) {
-        syslog(LOG_ERR, "BIRD command too long.");
+    trace_phase_end(TRACE_PHASE_FIRST_PDU);
+    trace_phase_begin(TRACE_PHASE_BIRD_LOAD);
+    if (roa_union_allowed(data, record))
+        roa_union_send(data, record, added);
+}
+
+/**
+ * Replays the configured update trace to BIRD and reports the rate.
+ * @return
+ */
+static int run_replay(void)
+{
+    const uint64_t begin = util_clock();
+    long count = replay_run(config.replay_file, config.replay_speed,
+                            replay_callback, &roa_union, &time_to_die);
+    // The rate includes sending everything to BIRD.
+    for (size_t i = 0; i < roa_union.writers_len; i++)
+        bird_writer_wait_idle(&bird_writers[i], &time_to_die);
+    const double seconds = (util_clock() - begin) / 1e6;
+    if (count < 0)
+        return EXIT_FAILURE;
+    fprintf(stderr, "Replayed %ld updates in %.3f s: %.0f updates/s\n",
+            count, seconds, seconds > 0 ? count / seconds : 0);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Returns nonzero if all RTR caches are in sync.
+ * @return
+ */
+static int rtr_caches_in_sync(void)
+{
+    for (size_t i = 0; i < rtr_caches_len; i++) {
+        if (!rtr_mgr_conf_in_sync(rtr_caches[i].conf))
+            return 0;
+    }
+    return 1;
+}
+
+/**
+ * Lists the RTR caches not in sync as "host:port" separated by spaces,
+ * truncated to the buffer size.
+ * @param list
+ * @param size
+ * @return Number of RTR caches not in sync.
+ */
+static size_t rtr_caches_unsynced(char *list, size_t size)
+{
+    size_t count = 0;
+    size_t len = 0;
+    list[0] = '\0';
+    for (size_t i = 0; i < rtr_caches_len; i++) {
+        if (rtr_mgr_conf_in_sync(rtr_caches[i].conf))
+            continue;
+        if (len < size)
+            len += snprintf(list + len, size - len, "%s%s:%s",
+                            count ? " " : "", rtr_caches[i].host,
+                            rtr_caches[i].port);
+        count++;
+    }
+    return count;
+}
+
+/**
+ * Sets up the transport and RTR manager of a session with the RTR cache at
+ * the specified host and port. Returns 0 on success or -1 on failure.
+ * @param cache
+ * @param host
+ * @param port
+ * @return
+ */
+static int init_rtr_cache(struct rtr_cache *cache, const char *host,
+                          const char *port)
+{
+    struct tr_tcp_config *tcp_config;
+    struct tr_ssh_config *ssh_config;
+    // Set up the transport depending on requested connection type.
+    switch (config.rtr_connection_type) {
+        case tcp:
+            tcp_config = rtr_create_tcp_config(host, port,
+                                               config.rtr_bind_addr);
+            tr_tcp_init(tcp_config, &cache->tr_socket);
+            break;
+        case ssh:
+            ssh_config = rtr_create_ssh_config(
+                host, port, config.rtr_bind_addr,
+                config.rtr_ssh_hostkey_file, config.rtr_ssh_username,
+                config.rtr_ssh_privkey_file);
+            tr_ssh_init(ssh_config, &cache->tr_socket);
+            break;
+        default:
+            syslog(LOG_ERR, "Invalid connection type, use tcp or ssh!\n");
+            return -1;
+    }
+    // init rtr_socket and group
+    rtr_cache_init(cache, &roa_union, host, port);
+    // init rtr_mgr
+    int ret = rtr_mgr_init(&cache->conf, &cache->group, 1,
+                           RTR_REFRESH_INTERVAL, RTR_EXPIRE_INTERVAL,
+                           RTR_RETRY_INTERVAL, pfx_update_callback, NULL,
+                           rtr_cache_status, cache);
+    // check for init errors
+    if (ret == RTR_ERROR) {
+        syslog(LOG_ERR, "Error in rtr_mgr_init!\n");
+        rtr_cache_free(cache);
+        return -1;
+    }
+    else if (ret == RTR_INVALID_PARAM) {
+        syslog(LOG_ERR, "Invalid params passed to rtr_mgr_init\n");
+        rtr_cache_free(cache);
+        return -1;
+    }
+    // check if rtr_mgr config valid
+    if (!cache->conf) {
+        syslog(LOG_ERR, "No config for rtr manager!\n");
+        rtr_cache_free(cache);
+        return -1;
+    }
+    cache->pfx_table = cache->conf->pfx_table;
+    return 0;
+}
+
+/**
+ * Stops the sessions with all RTR caches, withdraws their ROAs from BIRD
+ * like a session that goes down and frees them.
+ */
+static void rtr_caches_free(void)
+{
+    // The writers may still read the ROA union, not the prefix tables.
+    stop_rtr_expiry();
+    for (size_t i = 0; i < rtr_caches_len; i++)
+        rtr_mgr_stop(rtr_caches[i].conf);
+    // Withdraw all ROAs of the sessions from BIRD and give it some time to
+    // take them before the writers stop.
+    for (size_t i = 0; i < rtr_caches_len && roa_union.writers_len; i++) {
+        const size_t withdrawn = rtr_cache_withdraw(&rtr_caches[i]);
+        if (withdrawn)
+            syslog(LOG_INFO, "Withdrawing %zu ROAs of RTR cache %s:%s",
+                   withdrawn, rtr_caches[i].host, rtr_caches[i].port);
+    }
+    for (size_t i = 0; i < roa_union.writers_len; i++)
+        if (bird_writer_drain(&bird_writers[i],
+                              BIRD_WRITER_DRAIN_TIMEOUT) != 0)
+            syslog(LOG_WARNING, "BIRD at %s did not take all withdrawals",
+                   bird_writers[i].socket_path);
+    free_bird_writers();
+    for (size_t i = 0; i < rtr_caches_len; i++) {
+        rtr_mgr_free(rtr_caches[i].conf);
+        rtr_cache_free(&rtr_caches[i]);
+    }
+    rtr_caches_len = 0;
+}
+
+/**
+ * Waits for the initial sync of all RTR caches, validates the configured
+ * file and reports the throughput.
+ * @return 0 on success, -1 if the file cannot be opened or read, the
+ * validation fails or the program is stopped before the caches are in sync.
+ */
+static int run_bulk_validation(void)
+{
+    struct bulk_stats stats;
+    FILE *in = stdin;
+    int ret;
+    // Validate against the full data set only.
+    while (!rtr_caches_in_sync() && time_to_die == 0)
+        usleep(100000);
+    if (time_to_die)
+        return -1;
+    if (strcmp(config.validate_file, "-") != 0)
+        in = fopen(config.validate_file, "r");
+    if (!in) {
+        syslog(LOG_ERR, "Failed to open %s: %m", config.validate_file);
+        return -1;
+    }
+    ret = bulk_validate(pfx_tables, rtr_caches_len, in, stdout,
+                        config.validate_threads, &stats);
+    if (ret == 0) {
+        const double rate = stats.seconds > 0 ?
+            stats.lookups / stats.seconds : 0;
+        fprintf(stderr,
+                "Validated %lu pairs in %.3f s: %.0f lookups/s, "
+                "%.0f lookups/s per thread (%u threads)\n",
+                stats.lookups, stats.seconds, rate,
+                rate / stats.threads, stats.threads);
+    }
+    if (in != stdin)
+        fclose(in);
+    return ret;
+}
+
+/**
+ * Notifies the service manager, called from the daemon loop at least twice
+ * per watchdog interval. Sends READY=1 once at least one RTR cache is in
+ * sync and every BIRD writer has its ROA set acknowledged, a status line
+ * with the load progress, the update rate and the caches still syncing
+ * every few seconds, and the watchdog ping.
+ */
+static void handle_notify(void)
+{
+    static int ready = 0;
+    static time_t last_status = 0;
+    static unsigned long last_sent = 0;
+    char state[512];
+    char unsynced[256];
+    if (!notify_enabled())
         return;
+    if (notify_watchdog_usec())
+        notify_send("WATCHDOG=1");
+    // Readiness and status. One cache in sync is enough to serve, the others
+    // only add to its ROAs.
+    const size_t waiting = rtr_caches_unsynced(unsynced, sizeof unsynced);
+    int in_sync = waiting < rtr_caches_len;
+    unsigned long sent = 0;
+    size_t queued = 0;
+    for (size_t i = 0; i < roa_union.writers_len; i++) {
+        struct bird_writer_stats stats;
+        bird_writer_get_stats(&bird_writers[i], &stats);
+        sent += stats.sent;
+        queued += stats.queued;
+        if (!bird_writer_in_sync(&bird_writers[i]))
+            in_sync = 0;
     }
-    // Log the BIRD command and send it to the BIRD server.
-    if (config.quiet != true) 
-        syslog(LOG_INFO, "To BIRD: %s", bird_command);
-    // reconnect bird_socket on SIGPIPE error, and resend BIRD command
-    while ((write(bird_socket, bird_command, strlen(bird_command)) < 0) &&
-           (errno == EPIPE)) {
-        if (config.quiet != true) 
-            syslog(LOG_ERR, "BIRD socket send failed, try reconnect!");
-        close(bird_socket);
-        bird_socket = bird_connect(config.bird_socket_path);
-    }
-    // Fetch BIRD answer, reconnect bird_socket on SIGPIPE while receive
-    int size = -1;
-    while (((size = read(bird_socket, bird_response, BIRD_RSP_SIZE-1)) <0) &&
-           (errno == EPIPE)){
-        syslog(LOG_ERR, "BIRD socket recv failed, try reconnect!");
-        close(bird_socket);
-        bird_socket = bird_connect(config.bird_socket_path);
-    }
-    // log answer, if any valid response
-    if (size > 0) {
-        bird_response[size] = 0;
-	// Any bird response that doesn't start with 0000 is bad
-	if ((strstr(bird_response, "0000") == NULL) && (strstr(bird_response, "0001") == NULL))
-		syslog(LOG_ERR,"Bird command %s resulted in: %s\n", bird_command, bird_response);
-//	else
-//		fprintf (stdout,"%s %s/%d \t", added ? "add" : "del", ip_addr_str, record.min_len);
-        if (config.quiet != true) 
-            syslog(LOG_INFO, "From BIRD: %s", bird_response);
+    const time_t now = time(NULL);
+    if (!ready && in_sync) {
+        ready = 1;
+        syslog(LOG_INFO, "Initial ROA set loaded, notifying readiness");
+        snprintf(state, sizeof state, "READY=1\nMAINPID=%d", (int) getpid());
+        notify_send(state);
+    } else if (now - last_status < NOTIFY_STATUS_INTERVAL) {
+        return;
     }
+    pthread_mutex_lock(&roa_union.mutex);
+    const size_t roas = vrp_store_count(&roa_union.store);
+    pthread_mutex_unlock(&roa_union.mutex);
+    const double rate = last_status && now > last_status ?
+        (double) (sent - last_sent) / (now - last_status) : 0;
+    snprintf(state, sizeof state,
+             "STATUS=%s: %zu ROAs, %lu updates sent to BIRD, %zu queued, "
+             "%.0f updates/s%s%s", ready ? "Serving" : "Loading", roas, sent,
+             queued, rate, waiting ? ", RTR caches syncing: " : "", unsynced);
+    notify_send(state);
+    last_status = now;
+    last_sent = sent;
 }
 
 /**
@@ -259,6 +647,13 @@ int main(int argc, char *argv[])
     // Buffer for commands and its length.
     char *command = 0;
     size_t command_len = 0;
+    // Buffer for query answers and its size.
+    char *answer = 0;
+    size_t answer_size = 0;
+    // Server for validation queries.
+    struct query_server query_server = { .socket = -1 };
+    // Exit status after the clean up.
+    int exit_code = EXIT_SUCCESS;
     // Initialize variables.
     config_init(&config);
     // Initialize framework.
@@ -275,11 +670,32 @@ int main(int argc, char *argv[])
         fprintf(stderr, "Invalid configuration parameters!\n");
         return EXIT_FAILURE;
     }
+    // Start the tracer early to capture all startup phases.
+    if (config.trace_file &&
+        trace_init(config.trace_file, config.trace_sample_rate) != 0) {
+        cleanup();
+        fprintf(stderr, "Failed to initialize tracer!\n");
+        return EXIT_FAILURE;
+    }
+    // Read the service manager environment before forking.
+    if (notify_init() != 0) {
+        trace_free();
+        cleanup();
+        fprintf(stderr, "Failed to set up service manager notifications!\n");
+        return EXIT_FAILURE;
+    }
     pid_t process_id = 0;
     pid_t sid = 0;
 
-    // Launch daemon if configured
-    if (config.daemon == true)
+    // Launch daemon if configured. A service manager expecting notifications
+    // supervises the process itself, so it is not forked then.
+    if (config.daemon == true && notify_enabled())
+    {
+	    if (config.pidfile != NULL)
+		    create_pidfile();
+	    syslog(LOG_INFO, "initiated and running.");
+    }
+    else if (config.daemon == true)
     {
 	    process_id = fork ();
 	    // fork failed
@@ -302,67 +718,66 @@ int main(int argc, char *argv[])
 	    chdir ("/");
     }
 
-    // Setup BIRD ROA table command argument.
-    if (config.bird_roa_table) {
-        init_bird_add_roa_table_arg(config.bird_roa_table);
+    // Write the trace on SIGUSR1, before any other thread inherits the mask.
+    if (start_trace_signal() != 0) {
+        cleanup();
+        syslog(LOG_ERR, "Failed to set up SIGUSR1 handling!\n");
+        return EXIT_FAILURE;
     }
-    // Setup BIRD command buffer.
-    init_bird_command();
-    // Try to connect to BIRD and bail out on failure.
-    bird_socket = bird_connect(config.bird_socket_path);
-    if (bird_socket == -1) {
+    // Setup the ROA union and a writer for every BIRD socket.
+    roa_union_init(&roa_union, bird_writers, config.ip_version,
+                   config.replay_file ? 0 : config.damp_half_life);
+    if (init_bird_writers(config.replay_file != NULL) != 0) {
+        free_bird_writers();
         cleanup();
-        syslog(LOG_ERR, "Failed to connect to BIRD socket!\n");
+        syslog(LOG_ERR, "Failed to set up BIRD writers!\n");
         return EXIT_FAILURE;
     }
-
-    struct tr_socket tr_sock;
-    struct tr_tcp_config *tcp_config;
-    struct tr_ssh_config *ssh_config;
-    // Try to connect to the RTR server depending on requested connection type.
-    switch (config.rtr_connection_type) {
-        case tcp:
-            tcp_config = rtr_create_tcp_config(
-                config.rtr_host, config.rtr_port, config.rtr_bind_addr);
-            tr_tcp_init(tcp_config, &tr_sock);
-            break;
-        case ssh:
-            ssh_config = rtr_create_ssh_config(
-                config.rtr_host, config.rtr_port, config.rtr_bind_addr,
-                config.rtr_ssh_hostkey_file, config.rtr_ssh_username,
-                config.rtr_ssh_privkey_file);
-            tr_ssh_init(ssh_config, &tr_sock);
-            break;
-        default:
-            cleanup();
-            syslog(LOG_ERR, "Invalid connection type, use tcp or ssh!\n");
-            return EXIT_FAILURE;
+    // Replay recorded updates instead of connecting to an RTR server.
+    if (config.replay_file) {
+        signal(SIGPIPE, sigpipe_handler);
+        signal(SIGTERM, sigkill_handler);
+        int ret = EXIT_FAILURE;
+        if (start_bird_writers() == 0)
+            ret = run_replay();
+        else
+            syslog(LOG_ERR, "Failed to start BIRD writer!\n");
+        free_bird_writers();
+        roa_union_free(&roa_union);
+        stop_trace_signal();
+        trace_write();
+        trace_free();
+        cleanup();
+        return ret;
     }
-
-    struct rtr_socket rtr;
-    struct rtr_mgr_config *conf;
-    struct rtr_mgr_group groups[1];
-    // init rtr_socket and groups
-    rtr.tr_socket = &tr_sock;
-    groups[0].sockets_len = 1;
-    groups[0].sockets = malloc(1 * sizeof(rtr));
-    groups[0].sockets[0] = &rtr;
-    groups[0].preference = 1;
-    // init rtr_mgr
-    int ret = rtr_mgr_init(&conf, groups, 1, 30, 600, 600,
-                           pfx_update_callback, NULL, NULL, NULL);
-    // check for init errors
-    if (ret == RTR_ERROR) {
-        syslog(LOG_ERR, "Error in rtr_mgr_init!\n");
+    // Start recording before any update can arrive.
+    if (config.record_file && record_open(config.record_file) != 0) {
+        cleanup();
+        syslog(LOG_ERR, "Failed to open record file!\n");
         return EXIT_FAILURE;
     }
-    else if (ret == RTR_INVALID_PARAM) {
-        syslog(LOG_ERR, "Invalid params passed to rtr_mgr_init\n");
-        return EXIT_FAILURE;
+
+    // Set up a session with every RTR cache, all feed the ROA union.
+    trace_phase_begin(TRACE_PHASE_TRANSPORT_INIT);
+    for (unsigned int i = 0; i < config.rtr_servers; i++) {
+        if (init_rtr_cache(&rtr_caches[i], config.rtr_host[i],
+                           config.rtr_port[i]) != 0) {
+            rtr_caches_free();
+            cleanup();
+            return EXIT_FAILURE;
+        }
+        pfx_tables[i] = rtr_caches[i].conf->pfx_table;
+        rtr_caches_len++;
     }
-    // check if rtr_mgr config valid
-    if (!conf) {
-        syslog(LOG_ERR, "No config for rtr manager!\n");
+    trace_phase_end(TRACE_PHASE_TRANSPORT_INIT);
+    // start serving validation queries
+    if (config.query_socket &&
+        query_server_start(&query_server, config.query_socket,
+                           pfx_tables, rtr_caches_len, write_stats,
+                           &roa_union) != 0) {
+        rtr_caches_free();
+        cleanup();
+        syslog(LOG_ERR, "Failed to start query server!\n");
         return EXIT_FAILURE;
     }
     // set handler for SIGPIPE
@@ -370,42 +785,89 @@ int main(int argc, char *argv[])
     // set handler for SIGKILL and SIGTERM
     signal(SIGKILL, sigkill_handler);
     signal(SIGTERM, sigkill_handler);
+    // Connect to BIRD in the background, the RTR session does not wait for
+    // it and BIRD gets the full set once it is available.
+    if (start_bird_writers() != 0 ||
+        roa_union_start_damping(&roa_union) != 0 ||
+        (roa_union.writers_len > 0 && start_rtr_expiry() != 0)) {
+        query_server_stop(&query_server);
+        roa_union_stop_damping(&roa_union);
+        rtr_caches_free();
+        cleanup();
+        syslog(LOG_ERR, "Failed to start BIRD writer!\n");
+        return EXIT_FAILURE;
+    }
     // start rtr_mgr
-    rtr_mgr_start(conf);
+    trace_phase_begin(TRACE_PHASE_RTR_MGR_START);
+    trace_phase_begin(TRACE_PHASE_FIRST_PDU);
+    for (size_t i = 0; i < rtr_caches_len; i++)
+        rtr_mgr_start(rtr_caches[i].conf);
+    trace_phase_end(TRACE_PHASE_RTR_MGR_START);
 
-    if (config.daemon == true)
+    if (config.validate_file)
+    {
+	    if (run_bulk_validation() != 0)
+		    exit_code = EXIT_FAILURE;
+    }
+    else if (config.daemon == true)
     {
 	    close(STDIN_FILENO);
 	    close(STDOUT_FILENO);
 	    close(STDERR_FILENO);
-	    // Child loop
-	    while(time_to_die == 0)
-		    sleep(1);
+	    // Child loop, waking up at least twice per watchdog interval.
+	    uint64_t tick = 1000000;
+	    if (notify_watchdog_usec() && notify_watchdog_usec() / 2 < tick)
+		    tick = notify_watchdog_usec() / 2;
+	    while(time_to_die == 0) {
+		    handle_notify();
+		    usleep(tick);
+	    }
+	    notify_send("STOPPING=1");
     }
     else
     {
-	    fprintf(stdout, "bird-rtrlib-cli connected to %s:%s ready for IP versions %s.\nType 'exit' to clean up and quit.\n",
-		    config.rtr_host,
-		    config.rtr_port,
+	    fprintf(stdout, "bird-rtrlib-cli connected to");
+	    for (unsigned int i = 0; i < config.rtr_servers; i++)
+		    fprintf(stdout, " %s:%s", config.rtr_host[i],
+			    config.rtr_port[i]);
+	    fprintf(stdout, " ready for IP versions %s.\nType 'validate <prefix>/<length> <asn>' to query the RPKI data, 'stats' for metrics or 'exit' to clean up and quit.\n",
 		    config.ip_version ? config.ip_version : "all"
             );
 	    // CLI loop. Read commands from stdin.
 	    while (getline(&command, &command_len, stdin) != -1) {
 	        if (strncmp(command, CMD_EXIT, strlen(CMD_EXIT)) == 0)
 	            break;
+	        if (strncmp(command, CMD_TRACE, strlen(CMD_TRACE)) == 0)
+	            trace_write();
+	        if (query_is_query(command) || query_is_stats(command)) {
+	            if (!answer && (answer = malloc(QUERY_BUFFER_SIZE)))
+	                answer_size = QUERY_BUFFER_SIZE;
+	            if (answer &&
+	                query_reply(pfx_tables, rtr_caches_len, write_stats,
+	                            &roa_union, command, &answer, &answer_size,
+	                            0) >= 0) {
+	                fputs(answer, stdout);
+	                fflush(stdout);
+	            }
+	        }
     	    }
     }
-    // Clean up RTRLIB memory.
-    rtr_mgr_stop(conf);
-    rtr_mgr_free(conf);
-    free(groups[0].sockets);
-    // Close BIRD socket.
-    close(bird_socket);
-    // Cleanup memory.
-    cleanup_bird_command();
-    cleanup_bird_add_roa_table_arg();
+    // Stop answering queries.
+    query_server_stop(&query_server);
+    free(answer);
+    free(command);
+    // Clean up RTRLIB memory and the BIRD writers.
+    roa_union_stop_damping(&roa_union);
+    rtr_caches_free();
+    roa_union_free(&roa_union);
+    // Finish the recording.
+    record_close();
+    // Write and release the trace.
+    stop_trace_signal();
+    trace_write();
+    trace_free();
+    notify_free();
     // Cleanup framework.
     cleanup();
-    // Exit with success.
-    return EXIT_SUCCESS;
+    return exit_code;
 }
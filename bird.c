@@ -19,6 +19,8 @@
  * Website: https://github.com/rtrlib/bird-rtrlib-cli
  */
 
+#include <errno.h>
+#include <stdio.h>
 #include <string.h>
 #include <syslog.h>
 #include <sys/socket.h>
@@ -57,3 +59,63 @@ int bird_connect(const char *socket_path)
     // Return socket.
     return bird_socket;
 }
+
+void bird_reader_init(struct bird_reader *reader)
+{
+    reader->len = 0;
+    reader->pos = 0;
+}
+
+int bird_read_line(int socket, struct bird_reader *reader, char **line)
+{
+    for (;;) {
+        // Return the next complete line from the buffer.
+        char *begin = reader->buffer + reader->pos;
+        char *eol = memchr(begin, '\n', reader->len - reader->pos);
+        if (eol) {
+            *eol = 0;
+            *line = begin;
+            reader->pos = eol + 1 - reader->buffer;
+            return eol - begin;
+        }
+        // Move the incomplete rest to the front, truncate overlong lines.
+        reader->len -= reader->pos;
+        memmove(reader->buffer, begin, reader->len);
+        reader->pos = 0;
+        if (reader->len == BIRD_READER_SIZE - 1)
+            reader->len = BIRD_READER_SIZE / 2;
+        // Fill the buffer.
+        ssize_t n = read(socket, reader->buffer + reader->len,
+                         BIRD_READER_SIZE - 1 - reader->len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        reader->len += n;
+    }
+}
+
+int bird_line_code(const char *line)
+{
+    for (int i = 0; i < 4; i++)
+        if (line[i] < '0' || line[i] > '9')
+            return -2;
+    if (line[4] != ' ' && line[4] != 0)
+        return -2;
+    return (line[0] - '0') * 1000 + (line[1] - '0') * 100 +
+        (line[2] - '0') * 10 + (line[3] - '0');
+}
+
+int bird_read_reply(int socket, struct bird_reader *reader, char *msg,
+                    size_t msg_len)
+{
+    char *line;
+    int code;
+    do {
+        if (bird_read_line(socket, reader, &line) < 0)
+            return -1;
+    } while ((code = bird_line_code(line)) < 0);
+    if (msg_len > 0)
+        snprintf(msg, msg_len, "%s", line[4] ? line + 5 : "");
+    return code;
+}
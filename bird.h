@@ -22,6 +22,7 @@
 #ifndef BIRD_RTRLIB_CLI__BIRD_H
 #define	BIRD_RTRLIB_CLI__BIRD_H
 
+#include <stddef.h>
 #include <string.h>
 #include <syslog.h>
 #include <sys/socket.h>
@@ -36,4 +37,56 @@
  */
 int bird_connect(const char *socket_path);
 
+/// Size of the buffer for reading BIRD replies.
+#define BIRD_READER_SIZE (4096)
+/// Reply codes from this value on are errors.
+#define BIRD_CODE_ERROR (8000)
+
+/**
+ * Buffered reader for replies on a BIRD control socket.
+ */
+struct bird_reader {
+    char buffer[BIRD_READER_SIZE];
+    size_t len;
+    size_t pos;
+};
+
+/**
+ * Resets the reader, e.g., for a new connection.
+ * @param reader
+ */
+void bird_reader_init(struct bird_reader *reader);
+
+/**
+ * Reads a single line from BIRD and points `*line` to it, without the
+ * newline. The line is valid until the next call. Lines longer than the
+ * buffer are truncated. Returns the length of the line or -1 on failure or
+ * end of file.
+ * @param socket
+ * @param reader
+ * @param line
+ * @return
+ */
+int bird_read_line(int socket, struct bird_reader *reader, char **line);
+
+/**
+ * Returns the reply code of a line if it ends a reply ("DDDD text"), -2 if
+ * it is a continuation ("DDDD-text", " text" or an asynchronous "+text").
+ * @param line
+ * @return
+ */
+int bird_line_code(const char *line);
+
+/**
+ * Reads a complete reply from BIRD and copies the text of its last line to
+ * `msg`. Returns the reply code or -1 on failure.
+ * @param socket
+ * @param reader
+ * @param msg
+ * @param msg_len
+ * @return
+ */
+int bird_read_reply(int socket, struct bird_reader *reader, char *msg,
+                    size_t msg_len);
+
 #endif // BIRD_RTRLIB_CLI__BIRD_H
@@ -0,0 +1,298 @@
+/*
+ * This file is part of BIRD-RTRlib-CLI.
+ *
+ * BIRD-RTRlib-CLI is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * BIRD-RTRlib-CLI is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with BIRD-RTRlib-CLI; see the file COPYING.
+ *
+ * written by smlng and Mehmet Ceyran, in cooperation with:
+ * CST group, Freie Universitaet Berlin
+ * Website: https://github.com/rtrlib/bird-rtrlib-cli
+ */
+
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+
+#include "bulk.h"
+#include "query.h"
+#include "util.h"
+#include <rtrlib/rtrlib.h>
+
+// Estimated length of an answer line exceeding the length of its input line,
+// the output buffer of a worker grows if a line holds more pairs.
+#define BULK_ANSWER_OVERHEAD (32)
+
+struct bulk_pool;
+
+// Work of one thread: a slice of the current input block and its answers.
+struct bulk_worker {
+    struct bulk_pool *pool;
+    char *begin;
+    char *end;
+    char *out;
+    size_t out_size;
+    size_t out_len;
+    unsigned long lookups;
+    int error;
+    pthread_t thread;
+};
+
+// Workers started once and fed one input block after another.
+struct bulk_pool {
+    struct pfx_table **pfx_tables;
+    size_t pfx_tables_len;
+    struct bulk_worker *workers;
+    unsigned int threads;
+    unsigned int started;
+    pthread_mutex_t mutex;
+    // Signals a new block or the stop to the workers.
+    pthread_cond_t work;
+    // Signals the last worker finishing its slice.
+    pthread_cond_t done;
+    // Incremented for every block.
+    unsigned long block;
+    unsigned int pending;
+    int stop;
+};
+
+// Counts the lines in [begin, end).
+static size_t bulk_count_lines(const char *begin, const char *end)
+{
+    size_t lines = 0;
+    while ((begin = memchr(begin, '\n', end - begin))) {
+        lines++;
+        begin++;
+    }
+    return lines;
+}
+
+// Validates all lines of the worker's slice, one answer line per pair.
+static void bulk_worker_run(struct bulk_worker *worker)
+{
+    struct bulk_pool *pool = worker->pool;
+    char *line = worker->begin;
+    worker->out_len = 0;
+    while (line < worker->end) {
+        char *eol = memchr(line, '\n', worker->end - line);
+        *eol = 0;
+        char *out = worker->out + worker->out_len;
+        int len = query_answer(pool->pfx_tables, pool->pfx_tables_len, line,
+                               out, worker->out_size - worker->out_len);
+        // Grow the buffer for lines with more pairs than estimated.
+        if (len < 0) {
+            const size_t size = worker->out_size * 2;
+            char *buffer = realloc(worker->out, size);
+            if (!buffer) {
+                worker->error = 1;
+                break;
+            }
+            worker->out = buffer;
+            worker->out_size = size;
+            continue;
+        }
+        worker->lookups += bulk_count_lines(out, out + len);
+        worker->out_len += len;
+        line = eol + 1;
+    }
+}
+
+// Validates the slice of every block until the pool stops.
+static void *bulk_worker_thread(void *arg)
+{
+    struct bulk_worker *worker = arg;
+    struct bulk_pool *pool = worker->pool;
+    unsigned long block = 0;
+    pthread_mutex_lock(&pool->mutex);
+    for (;;) {
+        while (pool->block == block && !pool->stop)
+            pthread_cond_wait(&pool->work, &pool->mutex);
+        if (pool->stop)
+            break;
+        block = pool->block;
+        pthread_mutex_unlock(&pool->mutex);
+        bulk_worker_run(worker);
+        pthread_mutex_lock(&pool->mutex);
+        if (--pool->pending == 0)
+            pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
+}
+
+// Starts the worker threads. Returns 0 on success.
+static int bulk_pool_start(struct bulk_pool *pool)
+{
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    for (; pool->started < pool->threads; pool->started++) {
+        struct bulk_worker *worker = &pool->workers[pool->started];
+        worker->pool = pool;
+        if (pthread_create(&worker->thread, NULL, bulk_worker_thread,
+                           worker) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+// Stops and joins the worker threads.
+static void bulk_pool_stop(struct bulk_pool *pool)
+{
+    pthread_mutex_lock(&pool->mutex);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->mutex);
+    for (unsigned int i = 0; i < pool->started; i++)
+        pthread_join(pool->workers[i].thread, NULL);
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->work);
+    pthread_mutex_destroy(&pool->mutex);
+}
+
+// Returns the end of the line following `pos`, or `end` if there is none.
+static char *bulk_line_end(char *pos, char *end)
+{
+    char *eol = memchr(pos, '\n', end - pos);
+    return eol ? eol + 1 : end;
+}
+
+// Validates the complete lines in [block, block + len) and writes the answers
+// in order. Returns 0 on success.
+static int bulk_run_block(struct bulk_pool *pool, char *block, size_t len,
+                          FILE *out)
+{
+    char *end = block + len;
+    char *pos = block;
+    int error = 0;
+    // Split the block in slices of roughly equal size at line boundaries,
+    // the last workers may get empty slices.
+    for (unsigned int i = 0; i < pool->threads; i++) {
+        struct bulk_worker *worker = &pool->workers[i];
+        char *slice_end = i == pool->threads - 1 ? end :
+            bulk_line_end(pos + (end - pos) / (pool->threads - i), end);
+        // Room for the answers of one pair per line.
+        const size_t out_size = (slice_end - pos) +
+            bulk_count_lines(pos, slice_end) * BULK_ANSWER_OVERHEAD + 1;
+        if (worker->out_size < out_size) {
+            char *buffer = realloc(worker->out, out_size);
+            if (!buffer)
+                return -1;
+            worker->out = buffer;
+            worker->out_size = out_size;
+        }
+        worker->begin = pos;
+        worker->end = slice_end;
+        pos = slice_end;
+    }
+    pthread_mutex_lock(&pool->mutex);
+    pool->pending = pool->threads;
+    pool->block++;
+    pthread_cond_broadcast(&pool->work);
+    while (pool->pending > 0)
+        pthread_cond_wait(&pool->done, &pool->mutex);
+    pthread_mutex_unlock(&pool->mutex);
+    // Write the answers in input order.
+    for (unsigned int i = 0; i < pool->threads; i++) {
+        struct bulk_worker *worker = &pool->workers[i];
+        error |= worker->error;
+        if (!error && fwrite(worker->out, 1, worker->out_len, out) !=
+            worker->out_len)
+            error = 1;
+    }
+    return error ? -1 : 0;
+}
+
+int bulk_validate(struct pfx_table **pfx_tables, size_t pfx_tables_len,
+                  FILE *in, FILE *out, unsigned int threads,
+                  struct bulk_stats *stats)
+{
+    if (threads == 0)
+        threads = 1;
+    struct bulk_worker *workers = calloc(threads, sizeof (struct bulk_worker));
+    // Input block, with room for a terminating newline.
+    char *block = malloc(BULK_BLOCK_SIZE + 1);
+    size_t len = 0;
+    int ret = 0;
+    if (!workers || !block) {
+        syslog(LOG_ERR, "Failed to allocate bulk validation buffers");
+        free(workers);
+        free(block);
+        return -1;
+    }
+    struct bulk_pool pool = {
+        .pfx_tables = pfx_tables,
+        .pfx_tables_len = pfx_tables_len,
+        .workers = workers,
+        .threads = threads
+    };
+    if (bulk_pool_start(&pool) != 0) {
+        syslog(LOG_ERR, "Failed to start bulk validation threads");
+        bulk_pool_stop(&pool);
+        free(workers);
+        free(block);
+        return -1;
+    }
+    const uint64_t begin = util_clock();
+    for (;;) {
+        size_t n = fread(block + len, 1, BULK_BLOCK_SIZE - len, in);
+        if (n == 0 && ferror(in)) {
+            syslog(LOG_ERR, "Failed to read bulk validation input: %m");
+            ret = -1;
+            break;
+        }
+        len += n;
+        // Terminate the last line of the input.
+        if (n == 0 && len > 0 && block[len - 1] != '\n')
+            block[len++] = '\n';
+        if (len == 0)
+            break;
+        // Process complete lines, carry the rest over to the next block.
+        char *last = block + len - 1;
+        while (last >= block && *last != '\n')
+            last--;
+        // Read on until a line is complete.
+        if (last < block && len < BULK_BLOCK_SIZE)
+            continue;
+        if (last < block) {
+            syslog(LOG_ERR, "Bulk validation input line too long");
+            ret = -1;
+            break;
+        }
+        const size_t complete = last + 1 - block;
+        if (bulk_run_block(&pool, block, complete, out) != 0) {
+            syslog(LOG_ERR, "Bulk validation failed");
+            ret = -1;
+            break;
+        }
+        len -= complete;
+        memmove(block, block + complete, len);
+    }
+    const uint64_t end = util_clock();
+    bulk_pool_stop(&pool);
+    if (fflush(out) != 0)
+        ret = -1;
+    if (stats) {
+        stats->lookups = 0;
+        for (unsigned int i = 0; i < threads; i++)
+            stats->lookups += workers[i].lookups;
+        stats->seconds = (end - begin) / 1e6;
+        stats->threads = threads;
+    }
+    for (unsigned int i = 0; i < threads; i++)
+        free(workers[i].out);
+    free(workers);
+    free(block);
+    return ret;
+}
@@ -0,0 +1,60 @@
+/*
+ * This file is part of BIRD-RTRlib-CLI.
+ *
+ * BIRD-RTRlib-CLI is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * BIRD-RTRlib-CLI is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with BIRD-RTRlib-CLI; see the file COPYING.
+ *
+ * written by smlng and Mehmet Ceyran, in cooperation with:
+ * CST group, Freie Universitaet Berlin
+ * Website: https://github.com/rtrlib/bird-rtrlib-cli
+ */
+
+
+#ifndef BIRD_RTRLIB_CLI__BULK_H
+#define	BIRD_RTRLIB_CLI__BULK_H
+
+#include <stdio.h>
+
+struct pfx_table;
+
+/// Size of the input blocks split across the workers.
+#define BULK_BLOCK_SIZE (4 * 1024 * 1024)
+
+/**
+ * Statistics of a bulk validation run.
+ */
+struct bulk_stats {
+    unsigned long lookups;
+    double seconds;
+    unsigned int threads;
+};
+
+/**
+ * Validates all lines of "<prefix>/<length> <asn>" pairs read from `in`
+ * against the union of the prefix tables and writes one answer per pair to
+ * `out` in input order. The input is processed in blocks, each split across
+ * the specified number of worker threads, which are started once for the
+ * whole run. Returns 0 on success or -1 on failure.
+ * @param pfx_tables
+ * @param pfx_tables_len
+ * @param in
+ * @param out
+ * @param threads
+ * @param stats
+ * @return
+ */
+int bulk_validate(struct pfx_table **pfx_tables, size_t pfx_tables_len,
+                  FILE *in, FILE *out, unsigned int threads,
+                  struct bulk_stats *stats);
+
+#endif // BIRD_RTRLIB_CLI__BULK_H
@@ -0,0 +1,287 @@
+/*
+ * This file is part of BIRD-RTRlib-CLI.
+ *
+ * BIRD-RTRlib-CLI is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * BIRD-RTRlib-CLI is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with BIRD-RTRlib-CLI; see the file COPYING.
+ *
+ * written by smlng and Mehmet Ceyran, in cooperation with:
+ * CST group, Freie Universitaet Berlin
+ * Website: https://github.com/rtrlib/bird-rtrlib-cli
+ */
+
+
+#include <syslog.h>
+
+#include "cache.h"
+#include "trace.h"
+
+void rtr_cache_init(struct rtr_cache *cache, struct roa_union *roa_union,
+                    const char *host, const char *port)
+{
+    cache->host = host;
+    cache->port = port;
+    cache->roa_union = roa_union;
+    pthread_mutex_init(&cache->mutex, NULL);
+    vrp_store_init(&cache->applied, 0);
+    cache->established = 0;
+    cache->resync_at = 0;
+    cache->rtr_socket.tr_socket = &cache->tr_socket;
+    cache->sockets[0] = &cache->rtr_socket;
+    cache->group.sockets = cache->sockets;
+    cache->group.sockets_len = 1;
+    cache->group.preference = 1;
+}
+
+void rtr_cache_free(struct rtr_cache *cache)
+{
+    vrp_store_free(&cache->applied);
+    pthread_mutex_destroy(&cache->mutex);
+}
+
+/**
+ * Applies an update of an established session to its ROAs and the union.
+ * @param cache
+ * @param record
+ * @param added
+ */
+static void rtr_cache_apply(struct rtr_cache *cache,
+                            const struct pfx_record *record, int added)
+{
+    if (added) {
+        const int ret = vrp_store_add(&cache->applied, record, NULL);
+        if (ret < 0)
+            syslog(LOG_ERR, "Failed to add ROA of %s:%s", cache->host,
+                   cache->port);
+        if (ret != 1)
+            return;
+    } else if (vrp_store_remove(&cache->applied, record) != 1) {
+        return;
+    }
+    roa_union_update(cache->roa_union, record, added);
+}
+
+/**
+ * Allowed records of a prefix table collected into a store.
+ */
+struct rtr_cache_collection {
+    const struct roa_union *roa_union;
+    struct vrp_store *store;
+};
+
+/**
+ * Callback for iterating a prefix table, adds allowed records to a store.
+ * @param record
+ * @param data
+ */
+static void rtr_cache_collect(const struct pfx_record *record, void *data)
+{
+    struct rtr_cache_collection *collection = data;
+    if (roa_union_allowed(collection->roa_union, record) &&
+        vrp_store_add(collection->store, record, NULL) < 0)
+        syslog(LOG_ERR, "Failed to collect ROA");
+}
+
+/**
+ * Difference of two ROA sets applied to the union.
+ */
+struct rtr_cache_diff {
+    struct roa_union *roa_union;
+    const struct vrp_store *other;
+    int added;
+    size_t count;
+};
+
+/**
+ * Callback for iterating a ROA set, applies ROAs missing in the other set.
+ * @param record
+ * @param value
+ * @param data
+ */
+static void rtr_cache_diff_callback(const struct pfx_record *record,
+                                    void *value, void *data)
+{
+    struct rtr_cache_diff *diff = data;
+    if (vrp_store_find(diff->other, record, NULL) == 1)
+        return;
+    roa_union_update(diff->roa_union, record, diff->added);
+    diff->count++;
+}
+
+/**
+ * Collects the allowed ROAs in the prefix table of the session.
+ * @param cache
+ * @param current
+ */
+static void rtr_cache_collect_table(struct rtr_cache *cache,
+                                    struct vrp_store *current)
+{
+    struct rtr_cache_collection collection = { cache->roa_union, current };
+    vrp_store_init(current, 0);
+    pfx_table_for_each_ipv4_record(cache->pfx_table, rtr_cache_collect,
+                                   &collection);
+    pfx_table_for_each_ipv6_record(cache->pfx_table, rtr_cache_collect,
+                                   &collection);
+}
+
+/**
+ * Brings the ROAs of the session in line with the collected state of its
+ * prefix table, e.g., after a cache reset, by applying only the difference.
+ * New ROAs are added before the withdrawn ones are deleted, so BIRD never
+ * sees the set drained. Takes over `current`, must be called with the
+ * session locked.
+ * @param cache
+ * @param current
+ */
+static void rtr_cache_sync_to(struct rtr_cache *cache,
+                              struct vrp_store *current)
+{
+    struct rtr_cache_diff added = { cache->roa_union, &cache->applied, 1, 0 };
+    struct rtr_cache_diff withdrawn = { cache->roa_union, current, 0, 0 };
+    vrp_store_for_each(current, rtr_cache_diff_callback, &added);
+    vrp_store_for_each(&cache->applied, rtr_cache_diff_callback, &withdrawn);
+    vrp_store_free(&cache->applied);
+    cache->applied = *current;
+    syslog(LOG_INFO, "RTR cache %s:%s synced: %zu ROAs, %zu added, "
+           "%zu withdrawn", cache->host, cache->port,
+           vrp_store_count(&cache->applied), added.count, withdrawn.count);
+}
+
+/**
+ * Returns nonzero while the RTR socket replaces all its data after a cache
+ * reset or a new session ID. RTRlib does not necessarily report this with
+ * a status change of the manager. Other threads only get a hint, as the
+ * socket thread changes the fields without a lock.
+ * @param socket
+ * @return
+ */
+static int rtr_socket_resetting(const struct rtr_socket *socket)
+{
+    return socket->is_resetting || socket->request_session_id ||
+        socket->state == RTR_RESET ||
+        socket->state == RTR_ERROR_NO_INCR_UPDATE_AVAIL;
+}
+
+/**
+ * Holds back the updates of the session until it is in sync again. Must be
+ * called with the session locked.
+ * @param cache
+ */
+static void rtr_cache_hold(struct rtr_cache *cache)
+{
+    cache->established = 0;
+    cache->resync_at = time(NULL) + RTR_EXPIRE_INTERVAL;
+}
+
+/**
+ * Applies the complete state of a session that is in sync and passes its
+ * updates from then on. Takes over `current`, must be called with the
+ * session locked.
+ * @param cache
+ * @param current
+ */
+static void rtr_cache_establish(struct rtr_cache *cache,
+                                struct vrp_store *current)
+{
+    trace_phase_end(TRACE_PHASE_INITIAL_SYNC);
+    cache->established = 1;
+    cache->resync_at = 0;
+    rtr_cache_sync_to(cache, current);
+    // The BIRD load ends once the writers have sent everything.
+    for (size_t i = 0; i < cache->roa_union->writers_len; i++)
+        bird_writer_sync_done(&cache->roa_union->writers[i]);
+}
+
+void rtr_cache_update(struct rtr_cache *cache, const struct pfx_record *record,
+                      int added)
+{
+    // Updates of a session being (re)synchronized are applied as a whole
+    // once it is established.
+    pthread_mutex_lock(&cache->mutex);
+    if (cache->established && rtr_socket_resetting(record->socket))
+        rtr_cache_hold(cache);
+    if (cache->established && roa_union_allowed(cache->roa_union, record))
+        rtr_cache_apply(cache, record, added);
+    pthread_mutex_unlock(&cache->mutex);
+}
+
+void rtr_cache_status(const struct rtr_mgr_group *group,
+                      enum rtr_mgr_status status,
+                      const struct rtr_socket *socket, void *data)
+{
+    struct rtr_cache *cache = data;
+    // Without BIRD, i.e., in bulk validation mode, there is no union.
+    if (cache->roa_union->writers_len == 0)
+        return;
+    pthread_mutex_lock(&cache->mutex);
+    if (status == RTR_MGR_ESTABLISHED) {
+        // Apply the complete new state of a (re)synchronized session, even
+        // if RTRlib still reports the socket as resetting: its table holds
+        // the replacement by now.
+        if (!cache->established) {
+            // The socket thread is the only one changing the table.
+            struct vrp_store current;
+            rtr_cache_collect_table(cache, &current);
+            rtr_cache_establish(cache, &current);
+        }
+    } else if (cache->established) {
+        // Keep the applied ROAs until the session is in sync again.
+        rtr_cache_hold(cache);
+    }
+    pthread_mutex_unlock(&cache->mutex);
+}
+
+void rtr_cache_expire(struct rtr_cache *cache, time_t now)
+{
+    pthread_mutex_lock(&cache->mutex);
+    const int established = cache->established;
+    const time_t resync_at = cache->resync_at;
+    pthread_mutex_unlock(&cache->mutex);
+    // A reset of an established session may end without a status change,
+    // so its socket is polled for having finished it.
+    const struct rtr_socket *socket = &cache->rtr_socket;
+    const int in_sync = socket->state == RTR_ESTABLISHED &&
+        !rtr_socket_resetting(socket);
+    if (established || ((!resync_at || now < resync_at) && !in_sync))
+        return;
+    // The prefix table is read without the session locked, the socket
+    // thread may hold its lock while calling back.
+    struct vrp_store current;
+    rtr_cache_collect_table(cache, &current);
+    pthread_mutex_lock(&cache->mutex);
+    if (cache->established || cache->resync_at != resync_at) {
+        vrp_store_free(&current);
+    } else if (in_sync) {
+        syslog(LOG_INFO, "RTR cache %s:%s in sync again", cache->host,
+               cache->port);
+        rtr_cache_establish(cache, &current);
+    } else {
+        syslog(LOG_INFO, "RTR cache %s:%s down since expiry, applying its "
+               "remaining data", cache->host, cache->port);
+        rtr_cache_sync_to(cache, &current);
+        cache->resync_at = now + RTR_REFRESH_INTERVAL;
+    }
+    pthread_mutex_unlock(&cache->mutex);
+}
+
+size_t rtr_cache_withdraw(struct rtr_cache *cache)
+{
+    struct vrp_store none;
+    struct rtr_cache_diff withdrawn = { cache->roa_union, &none, 0, 0 };
+    vrp_store_init(&none, 0);
+    pthread_mutex_lock(&cache->mutex);
+    vrp_store_for_each(&cache->applied, rtr_cache_diff_callback, &withdrawn);
+    vrp_store_clear(&cache->applied);
+    pthread_mutex_unlock(&cache->mutex);
+    vrp_store_free(&none);
+    return withdrawn.count;
+}
@@ -0,0 +1,130 @@
+/*
+ * This file is part of BIRD-RTRlib-CLI.
+ *
+ * BIRD-RTRlib-CLI is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * BIRD-RTRlib-CLI is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with BIRD-RTRlib-CLI; see the file COPYING.
+ *
+ * written by smlng and Mehmet Ceyran, in cooperation with:
+ * CST group, Freie Universitaet Berlin
+ * Website: https://github.com/rtrlib/bird-rtrlib-cli
+ */
+
+#ifndef BIRD_RTRLIB_CLI__CACHE_H
+#define	BIRD_RTRLIB_CLI__CACHE_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <time.h>
+
+#include "union.h"
+#include "vrp.h"
+#include <rtrlib/rtrlib.h>
+
+// Intervals of the RTR sessions in seconds.
+#define RTR_REFRESH_INTERVAL (30)
+#define RTR_EXPIRE_INTERVAL (600)
+#define RTR_RETRY_INTERVAL (600)
+
+/**
+ * Session with one RTR cache. The RTR socket is embedded, so callbacks get
+ * to the session of a record through its socket pointer. `applied` holds
+ * the ROAs the session contributes to the union. While the session is not
+ * established or its socket replaces the data after a cache reset or a new
+ * session ID, its updates are held back and the union keeps the previous
+ * state until the new one is complete. `resync_at` is the time the held
+ * back state is applied anyway, once RTRlib has dropped expired data.
+ */
+struct rtr_cache {
+    const char *host;
+    const char *port;
+    struct tr_socket tr_socket;
+    struct rtr_socket rtr_socket;
+    struct rtr_socket *sockets[1];
+    struct rtr_mgr_group group;
+    struct rtr_mgr_config *conf;
+    struct pfx_table *pfx_table;
+    struct roa_union *roa_union;
+    // Protects the fields below against the expiry thread.
+    pthread_mutex_t mutex;
+    struct vrp_store applied;
+    int established;
+    time_t resync_at;
+};
+
+// Returns the session owning the specified RTR socket.
+#define rtr_cache_of(socket) ((struct rtr_cache *) \
+    ((char *) (socket) - offsetof(struct rtr_cache, rtr_socket)))
+
+/**
+ * Initializes the session with the RTR cache at the specified host and
+ * port, feeding the union, and its RTR manager group. The transport socket
+ * is set up by the caller, and `conf` and `pfx_table` once the RTR manager
+ * is.
+ * @param cache
+ * @param roa_union
+ * @param host
+ * @param port
+ */
+void rtr_cache_init(struct rtr_cache *cache, struct roa_union *roa_union,
+                    const char *host, const char *port);
+
+/**
+ * Releases the memory of the session, but not its RTR manager.
+ * @param cache
+ */
+void rtr_cache_free(struct rtr_cache *cache);
+
+/**
+ * Applies an update of the prefix table of the session, or holds it back
+ * while the session is being (re)synchronized. Must be called from the
+ * thread of the RTR socket.
+ * @param cache
+ * @param record
+ * @param added
+ */
+void rtr_cache_update(struct rtr_cache *cache, const struct pfx_record *record,
+                      int added);
+
+/**
+ * Status callback of the RTR manager of a session, `data` is the session.
+ * Applies the complete new state once the session is established, even if
+ * its socket still reports a reset, and holds back its updates otherwise.
+ * @param group
+ * @param status
+ * @param socket
+ * @param data
+ */
+void rtr_cache_status(const struct rtr_mgr_group *group,
+                      enum rtr_mgr_status status,
+                      const struct rtr_socket *socket, void *data);
+
+/**
+ * Applies the state of a held back session once its RTR socket is in sync
+ * again, or when it is due, i.e., after the expiry interval and again every
+ * refresh interval until the session is established again. Called once per
+ * second, as it does not depend on a status callback, which a quiet session
+ * or a reset of an established one may never get.
+ * @param cache
+ * @param now
+ */
+void rtr_cache_expire(struct rtr_cache *cache, time_t now);
+
+/**
+ * Withdraws all ROAs of the session from the union, e.g., at exit. Returns
+ * the number of ROAs withdrawn.
+ * @param cache
+ * @return
+ */
+size_t rtr_cache_withdraw(struct rtr_cache *cache);
+
+#endif // BIRD_RTRLIB_CLI__CACHE_H
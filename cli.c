@@ -20,7 +20,11 @@
  */
 
 #include <argp.h>
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
 #include <stddef.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "config.h"
@@ -37,6 +41,48 @@
 #define ARGKEY_QUIET 'q'
 #define ARGKEY_DAEMON 'd'
 #define ARGKEY_PIDFILE 'p'
+#define ARGKEY_TRACE_FILE 0x104
+#define ARGKEY_TRACE_SAMPLE_RATE 0x105
+#define ARGKEY_QUERY_SOCKET 0x106
+#define ARGKEY_VALIDATE_FILE 0x107
+#define ARGKEY_VALIDATE_THREADS 0x108
+#define ARGKEY_RECORD_FILE 0x109
+#define ARGKEY_REPLAY_FILE 0x10a
+#define ARGKEY_REPLAY_SPEED 0x10b
+#define ARGKEY_SORT_THRESHOLD 0x10c
+#define ARGKEY_AUDIT_INTERVAL 0x10d
+#define ARGKEY_DAMP_HALF_LIFE 0x10e
+#define ARGKEY_BIRD_WINDOW 0x10f
+
+// Parses the value of a numeric option as an integer in [min, max], fails
+// the parse with an error for anything else.
+static unsigned int cli_parse_uint(struct argp_state *state, const char *name,
+                                   const char *arg, unsigned long min,
+                                   unsigned long max)
+{
+    char *end;
+    errno = 0;
+    const unsigned long value = strtoul(arg, &end, 10);
+    if (errno || end == arg || *end || arg[strspn(arg, " ")] == '-' ||
+        value < min || value > max)
+        argp_error(state, "Invalid %s '%s', use a number from %lu to %lu.",
+                   name, arg, min, max);
+    return value;
+}
+
+// Parses the value of a numeric option as a finite number of at least min,
+// fails the parse with an error for anything else.
+static double cli_parse_double(struct argp_state *state, const char *name,
+                               const char *arg, double min)
+{
+    char *end;
+    errno = 0;
+    const double value = strtod(arg, &end);
+    if (errno || end == arg || *end || !isfinite(value) || value < min)
+        argp_error(state, "Invalid %s '%s', use a number of at least %g.",
+                   name, arg, min);
+    return value;
+}
 
 // Parser function for argp_parse().
 static error_t argp_parser(int key, char *arg, struct argp_state *state)
@@ -49,12 +95,20 @@ static error_t argp_parser(int key, char *arg, struct argp_state *state)
             config->bird_roa_table = arg;
             break;
         case ARGKEY_BIRD_SOCKET:
-            // Process BIRD socket path.
-            config->bird_socket_path = arg;
+            // Process BIRD socket path, every one gets all updates.
+            if (config->bird_sockets == CONFIG_MAX_BIRD_SOCKETS)
+                argp_error(state, "At most %d BIRD sockets are supported.",
+                           CONFIG_MAX_BIRD_SOCKETS);
+            config->bird_socket_path[config->bird_sockets++] = arg;
             break;
         case ARGKEY_RTR_ADDRESS:
-            config->rtr_host = strtok(arg, ":");
-            config->rtr_port = strtok(0, ":");
+            // Every RTR server given adds a cache to the merged data set.
+            if (config->rtr_servers == CONFIG_MAX_RTR_SERVERS)
+                argp_error(state, "At most %d RTR servers are supported.",
+                           CONFIG_MAX_RTR_SERVERS);
+            config->rtr_host[config->rtr_servers] = strtok(arg, ":");
+            config->rtr_port[config->rtr_servers] = strtok(0, ":");
+            config->rtr_servers++;
             break;
         case ARGKEY_RTR_SOURCE_ADDRESS:
             config->rtr_bind_addr = arg;
@@ -83,6 +137,62 @@ static error_t argp_parser(int key, char *arg, struct argp_state *state)
 	case ARGKEY_PIDFILE:
             config->pidfile = arg;
             break;
+        case ARGKEY_TRACE_FILE:
+            config->trace_file = arg;
+            break;
+        case ARGKEY_TRACE_SAMPLE_RATE:
+            config->trace_sample_rate = cli_parse_uint(state,
+                                                       "trace sample rate",
+                                                       arg, 1, UINT_MAX);
+            break;
+        case ARGKEY_QUERY_SOCKET:
+            config->query_socket = arg;
+            break;
+        case ARGKEY_VALIDATE_FILE:
+            config->validate_file = arg;
+            break;
+        case ARGKEY_VALIDATE_THREADS:
+            config->validate_threads = cli_parse_uint(
+                state, "number of validation threads", arg, 1,
+                CONFIG_MAX_VALIDATE_THREADS);
+            break;
+        case ARGKEY_RECORD_FILE:
+            config->record_file = arg;
+            break;
+        case ARGKEY_REPLAY_FILE:
+            config->replay_file = arg;
+            break;
+        case ARGKEY_REPLAY_SPEED:
+            config->replay_speed = cli_parse_double(state, "replay speed",
+                                                    arg, 0);
+            break;
+        case ARGKEY_SORT_THRESHOLD:
+            config->sort_threshold = cli_parse_uint(state, "sort threshold",
+                                                    arg, 0, UINT_MAX);
+            break;
+        case ARGKEY_AUDIT_INTERVAL:
+            config->audit_interval = cli_parse_uint(state, "audit interval",
+                                                    arg, 0, UINT_MAX);
+            break;
+        case ARGKEY_DAMP_HALF_LIFE:
+            config->damp_half_life = cli_parse_uint(state,
+                                                    "dampening half-life",
+                                                    arg, 0, UINT_MAX);
+            break;
+        case ARGKEY_BIRD_WINDOW:
+            // Either "<MIN>:<MAX>" or a fixed window "<N>".
+            {
+                char *max = strchr(arg, ':');
+                if (max)
+                    *max++ = 0;
+                config->bird_window_min = cli_parse_uint(
+                    state, "BIRD window", arg, 1, CONFIG_MAX_BIRD_WINDOW);
+                config->bird_window_max = max ?
+                    cli_parse_uint(state, "BIRD window", max, 1,
+                                   CONFIG_MAX_BIRD_WINDOW) :
+                    config->bird_window_min;
+            }
+            break;
         default:
             // Process unknown argument.
             return ARGP_ERR_UNKNOWN;
@@ -101,7 +211,8 @@ int parse_cli(int argc, char **argv, struct config *config)
             ARGKEY_BIRD_SOCKET,
             "<BIRD_SOCKET_PATH>",
             0,
-            "Path to the BIRD control socket.",
+            "Path to the BIRD control socket. Can be given several times to "
+            "feed several BIRD instances.",
             0
         },
         {
@@ -112,12 +223,58 @@ int parse_cli(int argc, char **argv, struct config *config)
             "(optional) Name of the BIRD ROA table for RPKI ROA imports.",
             0
         },
+        {
+            "sort-threshold",
+            ARGKEY_SORT_THRESHOLD,
+            "<N>",
+            0,
+            "(optional) Sort batches of at least N updates by prefix and "
+            "drop superseded updates before sending them to BIRD, 0 disables "
+            "sorting. Defaults to 1024.",
+            0
+        },
+        {
+            "audit-interval",
+            ARGKEY_AUDIT_INTERVAL,
+            "<SECONDS>",
+            0,
+            "(optional) Compare one chunk of BIRD's ROA table (an IPv4 /8, "
+            "an IPv6 /12 of 2000::/3 or the rest of the IPv6 space in three "
+            "chunks) with the RTR data every SECONDS seconds and repair any "
+            "difference, 0 disables the audit. Extra ROAs are deleted unless "
+            "BIRD keeps them, like static ones. Defaults to 1.",
+            0
+        },
+        {
+            "damp-half-life",
+            ARGKEY_DAMP_HALF_LIFE,
+            "<SECONDS>",
+            0,
+            "(optional) Dampen flapping ROAs: every withdrawal adds a penalty "
+            "that halves every SECONDS seconds, and ROAs with a high penalty "
+            "are announced to BIRD only after it has decayed. Withdrawals are "
+            "never delayed. Defaults to 0, i.e., disabled; 900 is a common "
+            "value.",
+            0
+        },
+        {
+            "bird-window",
+            ARGKEY_BIRD_WINDOW,
+            "<MIN>:<MAX>",
+            0,
+            "(optional) Number of commands sent to BIRD before reading the "
+            "answers. The window grows by one while BIRD answers within 20 ms "
+            "and is halved when it takes longer. A single number fixes the "
+            "window. Defaults to 1:64.",
+            0
+        },
         {
             "rtr-address",
             ARGKEY_RTR_ADDRESS,
             "<RTR_HOST>:<RTR_PORT>",
             0,
-            "Address of the RTR server.",
+            "Address of the RTR server. Can be given several times, BIRD "
+            "then gets the union of the ROAs of all servers.",
             1
         },
         {
@@ -196,6 +353,79 @@ int parse_cli(int argc, char **argv, struct config *config)
 	    "(Optional) Name of the pidfile",
 	    2
 	},
+        {
+            "trace-file",
+            ARGKEY_TRACE_FILE,
+            "<TRACE_FILE>",
+            0,
+            "(optional) Record startup phases and sampled BIRD updates and "
+            "write them in Chrome trace format to this file on SIGUSR1, on "
+            "the 'trace' command and at exit.",
+            3
+        },
+        {
+            "trace-sample-rate",
+            ARGKEY_TRACE_SAMPLE_RATE,
+            "<N>",
+            0,
+            "(optional) Trace one out of N BIRD updates, defaults to 100.",
+            3
+        },
+        {
+            "query-socket",
+            ARGKEY_QUERY_SOCKET,
+            "<QUERY_SOCKET_PATH>",
+            0,
+            "(optional) Path of a Unix socket answering "
+            "'validate <prefix>/<length> <asn>' queries.",
+            3
+        },
+        {
+            "validate-file",
+            ARGKEY_VALIDATE_FILE,
+            "<FILE>",
+            0,
+            "(optional) Wait for the initial RTR sync, validate all "
+            "'<prefix>/<length> <asn>' lines of FILE (- for stdin), write the "
+            "results to stdout and exit. BIRD is not required in this mode.",
+            3
+        },
+        {
+            "validate-threads",
+            ARGKEY_VALIDATE_THREADS,
+            "<N>",
+            0,
+            "(optional) Number of bulk validation threads, defaults to the "
+            "number of CPUs.",
+            3
+        },
+        {
+            "record",
+            ARGKEY_RECORD_FILE,
+            "<FILE>",
+            0,
+            "(optional) Record every prefix update received from the RTR "
+            "server with its timestamp to FILE.",
+            4
+        },
+        {
+            "replay",
+            ARGKEY_REPLAY_FILE,
+            "<FILE>",
+            0,
+            "(optional) Send the updates recorded in FILE to BIRD instead of "
+            "connecting to an RTR server, then exit.",
+            4
+        },
+        {
+            "replay-speed",
+            ARGKEY_REPLAY_SPEED,
+            "<FACTOR>",
+            0,
+            "(optional) Replay at FACTOR times the recorded pace, 0 replays "
+            "as fast as possible. Defaults to 1.",
+            4
+        },
         {0}
     };
     // argp structure to be passed to argp_parse().
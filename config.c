@@ -21,6 +21,7 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "config.h"
 
@@ -32,21 +33,40 @@
  */
 int config_check(const struct config *config)
 {
-    // Check BIRD control socket path availability.
-    if (!config->bird_socket_path) {
+    // Check BIRD control socket path availability, bulk validation runs
+    // without BIRD.
+    if (config->bird_sockets == 0 && !config->validate_file) {
         fprintf(stderr, "Missing path to BIRD control socket.\n");
         return 1;
     }
-    // Check RTR host availability.
-    if (!config->rtr_host) {
-        fprintf(stderr, "Missing RTR server host.\n");
+    // Check the BIRD window bounds.
+    if (config->bird_window_min < 1 ||
+        config->bird_window_max < config->bird_window_min ||
+        config->bird_window_max > CONFIG_MAX_BIRD_WINDOW) {
+        fprintf(stderr, "Invalid BIRD window, use 1 <= MIN <= MAX <= %d.\n",
+                CONFIG_MAX_BIRD_WINDOW);
         return 1;
     }
-    // Check RTR port availability.
-    if (!config->rtr_port) {
-        fprintf(stderr, "Missing RTR server port.\n");
+    // A replay needs no RTR server.
+    if (config->replay_file)
+        return 0;
+    // Check RTR server availability.
+    if (config->rtr_servers == 0) {
+        fprintf(stderr, "Missing RTR server host.\n");
         return 1;
     }
+    for (unsigned int i = 0; i < config->rtr_servers; i++) {
+        // Check RTR host availability.
+        if (!config->rtr_host[i]) {
+            fprintf(stderr, "Missing RTR server host.\n");
+            return 1;
+        }
+        // Check RTR port availability.
+        if (!config->rtr_port[i]) {
+            fprintf(stderr, "Missing RTR server port.\n");
+            return 1;
+        }
+    }
     // Checks to be done for SSH connections.
     if (config->rtr_connection_type == ssh) {
         // Check SSH username availability.
@@ -69,4 +89,18 @@ void config_init(struct config *config)
     memset(config, 0, sizeof (struct config));
     // Default connection type is TCP.
     config->rtr_connection_type = tcp;
+    // Trace one out of 100 BIRD updates by default.
+    config->trace_sample_rate = 100;
+    // Validate with one thread per online CPU by default.
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    config->validate_threads = cpus > 0 ? cpus : 1;
+    // Replay at the recorded pace by default.
+    config->replay_speed = 1.0;
+    // Sort batches of at least 1024 updates before sending them to BIRD.
+    config->sort_threshold = 1024;
+    // Audit one chunk of BIRD's ROA table per second.
+    config->audit_interval = 1;
+    // Pipeline up to 64 commands to BIRD, adapting to its latency.
+    config->bird_window_min = 1;
+    config->bird_window_max = 64;
 }
@@ -22,6 +22,15 @@
 #ifndef BIRD_RTRLIB_CLI__CONFIG_H
 #define	BIRD_RTRLIB_CLI__CONFIG_H
 
+/// Maximum number of RTR servers whose data is merged.
+#define CONFIG_MAX_RTR_SERVERS (8)
+/// Maximum number of BIRD control sockets fed with the data.
+#define CONFIG_MAX_BIRD_SOCKETS (8)
+/// Maximum number of commands pipelined to BIRD.
+#define CONFIG_MAX_BIRD_WINDOW (1024)
+/// Maximum number of bulk validation threads.
+#define CONFIG_MAX_VALIDATE_THREADS (1024)
+
 /// Specifies a type of server connection to be used.
 enum connection_type {
     tcp, // Plain TCP connection
@@ -34,11 +43,13 @@ typedef enum { false, true } bool;
  * Application configuration structure.
  */
 struct config {
-    char *bird_socket_path;
+    char *bird_socket_path[CONFIG_MAX_BIRD_SOCKETS];
+    unsigned int bird_sockets;
     char *bird_roa_table;
     enum connection_type rtr_connection_type;
-    char *rtr_host;
-    char *rtr_port;
+    char *rtr_host[CONFIG_MAX_RTR_SERVERS];
+    char *rtr_port[CONFIG_MAX_RTR_SERVERS];
+    unsigned int rtr_servers;
     char *rtr_bind_addr;
     char *rtr_ssh_username;
     char *rtr_ssh_hostkey_file;
@@ -47,6 +58,19 @@ struct config {
     bool quiet;
     bool daemon;
     char *pidfile;
+    char *trace_file;
+    unsigned int trace_sample_rate;
+    char *query_socket;
+    char *validate_file;
+    unsigned int validate_threads;
+    char *record_file;
+    char *replay_file;
+    double replay_speed;
+    unsigned int sort_threshold;
+    unsigned int audit_interval;
+    unsigned int damp_half_life;
+    unsigned int bird_window_min;
+    unsigned int bird_window_max;
 };
 
 /**
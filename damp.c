@@ -0,0 +1,183 @@
+/*
+ * This file is part of BIRD-RTRlib-CLI.
+ *
+ * BIRD-RTRlib-CLI is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * BIRD-RTRlib-CLI is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with BIRD-RTRlib-CLI; see the file COPYING.
+ *
+ * written by smlng and Mehmet Ceyran, in cooperation with:
+ * CST group, Freie Universitaet Berlin
+ * Website: https://github.com/rtrlib/bird-rtrlib-cli
+ */
+
+
+
+#include <string.h>
+
+#include "damp.h"
+#include "update.h"
+
+// Dampening state of a ROA, the value in the store.
+struct damp_state {
+    uint32_t penalty;
+    int held;
+    time_t updated;
+};
+
+// Penalties are capped so that a ROA is held back for at most
+// DAMP_MAX_SUPPRESS half-lives after its last flap.
+#define DAMP_CEILING (DAMP_REUSE << DAMP_MAX_SUPPRESS)
+
+// Decays the penalty of a state to the specified time. The decay is exact
+// for whole half-lives and linear in between.
+static void damp_decay(const struct damp *damp, struct damp_state *state,
+                       time_t now)
+{
+    if (now <= state->updated)
+        return;
+    const time_t elapsed = now - state->updated;
+    const time_t halvings = elapsed / damp->half_life;
+    const time_t rest = elapsed % damp->half_life;
+    state->penalty = halvings >= 32 ? 0 : state->penalty >> halvings;
+    state->penalty -= (uint64_t) state->penalty * rest /
+        (2 * damp->half_life);
+    state->updated = now;
+}
+
+void damp_init(struct damp *damp, unsigned int half_life)
+{
+    memset(damp, 0, sizeof (struct damp));
+    vrp_store_init(&damp->store, sizeof (struct damp_state));
+    damp->half_life = half_life;
+}
+
+void damp_free(struct damp *damp)
+{
+    vrp_store_free(&damp->store);
+}
+
+int damp_announce(struct damp *damp, const struct pfx_record *record,
+                  time_t now)
+{
+    struct damp_state state;
+    void *value;
+    // Only ROAs that were withdrawn before have a state.
+    if (!damp->half_life || vrp_store_find(&damp->store, record, &value) != 1)
+        return 1;
+    memcpy(&state, value, sizeof state);
+    damp_decay(damp, &state, now);
+    if (!state.held && state.penalty >= DAMP_SUPPRESS) {
+        state.held = 1;
+        damp->stats.held++;
+        damp->stats.suppressed++;
+    }
+    memcpy(value, &state, sizeof state);
+    return !state.held;
+}
+
+int damp_withdraw(struct damp *damp, const struct pfx_record *record,
+                  time_t now)
+{
+    struct damp_state state;
+    void *value;
+    if (!damp->half_life)
+        return 1;
+    const int ret = vrp_store_add(&damp->store, record, &value);
+    if (ret < 0)
+        return 1;
+    memcpy(&state, value, sizeof state);
+    if (ret == 1)
+        state.updated = now;
+    damp_decay(damp, &state, now);
+    const int held = state.held;
+    state.penalty += DAMP_PENALTY;
+    if (state.penalty > DAMP_CEILING)
+        state.penalty = DAMP_CEILING;
+    if (held) {
+        state.held = 0;
+        damp->stats.suppressed--;
+    }
+    memcpy(value, &state, sizeof state);
+    damp->stats.flaps++;
+    damp->stats.tracked = vrp_store_count(&damp->store);
+    return !held;
+}
+
+int damp_is_held(const struct damp *damp, const struct pfx_record *record)
+{
+    struct damp_state state;
+    void *value;
+    if (!damp->half_life || vrp_store_find(&damp->store, record, &value) != 1)
+        return 0;
+    memcpy(&state, value, sizeof state);
+    return state.held;
+}
+
+// ROAs found by the release iteration.
+struct damp_release_data {
+    const struct damp *damp;
+    time_t now;
+    // Held back ROAs to release, and ROAs to forget.
+    struct update_batch released;
+    struct update_batch expired;
+    int failed;
+};
+
+// Collects a ROA if it is to be released or forgotten. The decayed penalty
+// is not stored, as repeated interpolation would slow down the decay.
+static void damp_release_callback(const struct pfx_record *record,
+                                  void *value, void *data)
+{
+    struct damp_release_data *release = data;
+    struct damp_state state;
+    memcpy(&state, value, sizeof state);
+    const uint32_t penalty = state.penalty;
+    const time_t updated = state.updated;
+    damp_decay(release->damp, &state, release->now);
+    if (state.held && state.penalty < DAMP_REUSE) {
+        if (update_batch_add(&release->released, record, 1) == 0)
+            state.held = 0;
+        else
+            release->failed = 1;
+    } else if (!state.held && state.penalty < DAMP_REUSE / 2 &&
+               update_batch_add(&release->expired, record, 0) != 0) {
+        release->failed = 1;
+    }
+    state.penalty = penalty;
+    state.updated = updated;
+    memcpy(value, &state, sizeof state);
+}
+
+int damp_release(struct damp *damp, time_t now, damp_release_fp fp,
+                 void *data)
+{
+    struct damp_release_data release;
+    if (!damp->half_life)
+        return 0;
+    release.damp = damp;
+    release.now = now;
+    update_batch_init(&release.released);
+    update_batch_init(&release.expired);
+    release.failed = 0;
+    vrp_store_for_each(&damp->store, damp_release_callback, &release);
+    // The store must not change while it is iterated.
+    for (size_t i = 0; i < release.expired.len; i++)
+        vrp_store_remove(&damp->store, &release.expired.updates[i].record);
+    for (size_t i = 0; i < release.released.len; i++)
+        fp(&release.released.updates[i].record, data);
+    damp->stats.released += release.released.len;
+    damp->stats.suppressed -= release.released.len;
+    damp->stats.tracked = vrp_store_count(&damp->store);
+    update_batch_free(&release.released);
+    update_batch_free(&release.expired);
+    return release.failed ? -1 : 0;
+}
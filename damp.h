@@ -0,0 +1,133 @@
+/*
+ * This file is part of BIRD-RTRlib-CLI.
+ *
+ * BIRD-RTRlib-CLI is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * BIRD-RTRlib-CLI is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with BIRD-RTRlib-CLI; see the file COPYING.
+ *
+ * written by smlng and Mehmet Ceyran, in cooperation with:
+ * CST group, Freie Universitaet Berlin
+ * Website: https://github.com/rtrlib/bird-rtrlib-cli
+ */
+
+
+
+#ifndef BIRD_RTRLIB_CLI__DAMP_H
+#define	BIRD_RTRLIB_CLI__DAMP_H
+
+#include <stdint.h>
+#include <time.h>
+
+#include "vrp.h"
+
+/// Penalty added for every withdrawal of a ROA.
+#define DAMP_PENALTY (1000)
+/// Announcements of ROAs with at least this penalty are held back.
+#define DAMP_SUPPRESS (2000)
+/// Held back ROAs are released once their penalty decays below this value.
+#define DAMP_REUSE (750)
+/// ROAs are held back for at most this many half-lives.
+#define DAMP_MAX_SUPPRESS (4)
+
+/**
+ * Counters of the flap dampening.
+ */
+struct damp_stats {
+    // Withdrawals counted as flaps.
+    unsigned long flaps;
+    // Announcements held back, and held back ROAs released after decaying.
+    unsigned long held;
+    unsigned long released;
+    // ROAs held back at the moment, and ROAs with a penalty.
+    size_t suppressed;
+    size_t tracked;
+};
+
+/**
+ * Flap dampening of ROAs like BGP route flap dampening (RFC 2439): every
+ * withdrawal adds a penalty that decays exponentially with the half-life,
+ * and announcements of ROAs whose penalty exceeds the suppress limit are
+ * held back until it decays below the reuse limit. Withdrawals are never
+ * delayed. The state of every ROA with a penalty is kept in a VRP store.
+ * Not thread safe.
+ */
+struct damp {
+    struct vrp_store store;
+    unsigned int half_life;
+    struct damp_stats stats;
+};
+
+/**
+ * Function called for every held back ROA released by `damp_release()`.
+ */
+typedef void (*damp_release_fp)(const struct pfx_record *record, void *data);
+
+/**
+ * Initializes the dampening with the specified half-life in seconds, 0
+ * disables it.
+ * @param damp
+ * @param half_life
+ */
+void damp_init(struct damp *damp, unsigned int half_life);
+
+/**
+ * Releases the memory of the dampening.
+ * @param damp
+ */
+void damp_free(struct damp *damp);
+
+/**
+ * Records an announcement of a ROA. Returns 1 if it is to be sent to BIRD
+ * or 0 if it is held back. Only ROAs tracked since a withdrawal can be held
+ * back, so this never allocates and cannot fail.
+ * @param damp
+ * @param record
+ * @param now
+ * @return
+ */
+int damp_announce(struct damp *damp, const struct pfx_record *record,
+                  time_t now);
+
+/**
+ * Records a withdrawal of a ROA as a flap. Returns 1 if it is to be sent to
+ * BIRD or 0 if the ROA was held back and BIRD never got it. If the ROA
+ * cannot be tracked, the withdrawal is sent without recording the flap.
+ * @param damp
+ * @param record
+ * @param now
+ * @return
+ */
+int damp_withdraw(struct damp *damp, const struct pfx_record *record,
+                  time_t now);
+
+/**
+ * Returns nonzero if the announcement of the ROA is held back.
+ * @param damp
+ * @param record
+ * @return
+ */
+int damp_is_held(const struct damp *damp, const struct pfx_record *record);
+
+/**
+ * Decays all penalties, calls `fp` for the held back ROAs that may be sent
+ * to BIRD again and forgets ROAs whose penalty has decayed. Returns 0 on
+ * success or -1 on failure.
+ * @param damp
+ * @param now
+ * @param fp
+ * @param data
+ * @return
+ */
+int damp_release(struct damp *damp, time_t now, damp_release_fp fp,
+                 void *data);
+
+#endif // BIRD_RTRLIB_CLI__DAMP_H
@@ -0,0 +1,106 @@
+/*
+ * This file is part of BIRD-RTRlib-CLI.
+ *
+ * BIRD-RTRlib-CLI is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * BIRD-RTRlib-CLI is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with BIRD-RTRlib-CLI; see the file COPYING.
+ *
+ * written by smlng and Mehmet Ceyran, in cooperation with:
+ * CST group, Freie Universitaet Berlin
+ * Website: https://github.com/rtrlib/bird-rtrlib-cli
+ */
+
+
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "notify.h"
+
+// Datagram socket to the service manager, -1 if disabled.
+static int notify_socket = -1;
+// Address of the service manager.
+static struct sockaddr_un notify_addr;
+static socklen_t notify_addr_len = 0;
+// Watchdog interval in microseconds, 0 if disabled.
+static uint64_t notify_watchdog = 0;
+
+int notify_init(void)
+{
+    const char *path = getenv("NOTIFY_SOCKET");
+    const char *watchdog = getenv("WATCHDOG_USEC");
+    const char *watchdog_pid = getenv("WATCHDOG_PID");
+    // The watchdog is meant for this process unless a PID says otherwise.
+    if (watchdog &&
+        (!watchdog_pid || strtol(watchdog_pid, NULL, 10) == getpid()))
+        notify_watchdog = strtoull(watchdog, NULL, 10);
+    if (!path || !path[0])
+        return 0;
+    const size_t len = strlen(path);
+    if ((path[0] != '/' && path[0] != '@') ||
+        len >= sizeof notify_addr.sun_path) {
+        syslog(LOG_ERR, "Invalid NOTIFY_SOCKET %s", path);
+        return -1;
+    }
+    memset(&notify_addr, 0, sizeof notify_addr);
+    notify_addr.sun_family = AF_UNIX;
+    memcpy(notify_addr.sun_path, path, len);
+    // A leading @ denotes an abstract socket.
+    if (path[0] == '@')
+        notify_addr.sun_path[0] = 0;
+    notify_addr_len = offsetof(struct sockaddr_un, sun_path) + len;
+    notify_socket = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (notify_socket < 0) {
+        syslog(LOG_ERR, "Notify socket creation error: %m");
+        return -1;
+    }
+    return 0;
+}
+
+void notify_free(void)
+{
+    if (notify_socket >= 0)
+        close(notify_socket);
+    notify_socket = -1;
+}
+
+int notify_enabled(void)
+{
+    return notify_socket >= 0;
+}
+
+uint64_t notify_watchdog_usec(void)
+{
+    return notify_socket >= 0 ? notify_watchdog : 0;
+}
+
+int notify_send(const char *state)
+{
+    if (notify_socket < 0)
+        return 0;
+    ssize_t n;
+    do {
+        n = sendto(notify_socket, state, strlen(state), MSG_NOSIGNAL,
+                   (struct sockaddr *) &notify_addr, notify_addr_len);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) {
+        syslog(LOG_ERR, "Failed to notify the service manager: %m");
+        return -1;
+    }
+    return 0;
+}
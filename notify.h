@@ -0,0 +1,66 @@
+/*
+ * This file is part of BIRD-RTRlib-CLI.
+ *
+ * BIRD-RTRlib-CLI is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * BIRD-RTRlib-CLI is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with BIRD-RTRlib-CLI; see the file COPYING.
+ *
+ * written by smlng and Mehmet Ceyran, in cooperation with:
+ * CST group, Freie Universitaet Berlin
+ * Website: https://github.com/rtrlib/bird-rtrlib-cli
+ */
+
+
+
+#ifndef BIRD_RTRLIB_CLI__NOTIFY_H
+#define	BIRD_RTRLIB_CLI__NOTIFY_H
+
+#include <stdint.h>
+
+/**
+ * Sets up notifications to the service manager if $NOTIFY_SOCKET is set,
+ * following the sd_notify protocol, and reads the watchdog interval from
+ * $WATCHDOG_USEC if it is meant for this process. Must be called before
+ * forking. Returns 0 on success, also if notifications are disabled, or -1
+ * on failure.
+ * @return
+ */
+int notify_init(void);
+
+/**
+ * Closes the notification socket.
+ */
+void notify_free(void);
+
+/**
+ * Returns nonzero if the service manager expects notifications.
+ * @return
+ */
+int notify_enabled(void);
+
+/**
+ * Returns the watchdog interval in microseconds, or 0 if the watchdog is
+ * disabled.
+ * @return
+ */
+uint64_t notify_watchdog_usec(void);
+
+/**
+ * Sends newline separated assignments like "READY=1" or "STATUS=..." to the
+ * service manager. Does nothing if notifications are disabled. Returns 0 on
+ * success or -1 on failure.
+ * @param state
+ * @return
+ */
+int notify_send(const char *state);
+
+#endif // BIRD_RTRLIB_CLI__NOTIFY_H
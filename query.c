@@ -0,0 +1,460 @@
+/*
+ * This file is part of BIRD-RTRlib-CLI.
+ *
+ * BIRD-RTRlib-CLI is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * BIRD-RTRlib-CLI is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with BIRD-RTRlib-CLI; see the file COPYING.
+ *
+ * written by smlng and Mehmet Ceyran, in cooperation with:
+ * CST group, Freie Universitaet Berlin
+ * Website: https://github.com/rtrlib/bird-rtrlib-cli
+ */
+
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "query.h"
+#include "util.h"
+#include <rtrlib/rtrlib.h>
+
+// Characters separating the tokens of a query.
+#define QUERY_DELIMITERS " \t\r\n"
+
+// Returns the next token of `line` starting at `*pos` and stores its length.
+static const char *query_next_token(const char **pos, size_t *len)
+{
+    const char *begin = *pos + strspn(*pos, QUERY_DELIMITERS);
+    *len = strcspn(begin, QUERY_DELIMITERS);
+    *pos = begin + *len;
+    return *len ? begin : 0;
+}
+
+// Parses "<prefix>/<length>" into address and length, returns 0 on success.
+static int query_parse_prefix(const char *token, size_t len,
+                              struct lrtr_ip_addr *prefix, uint8_t *mask_len)
+{
+    // Address part, long enough for an IPv6 address.
+    char addr[INET6_ADDRSTRLEN];
+    const char *slash = memchr(token, '/', len);
+    if (!slash || slash == token || (size_t) (slash - token) >= sizeof addr)
+        return -1;
+    memcpy(addr, token, slash - token);
+    addr[slash - token] = 0;
+    if (lrtr_ip_str_to_addr(addr, prefix) != 0)
+        return -1;
+    // Length part, bounded by the address family.
+    const unsigned int max_len = prefix->ver == LRTR_IPV4 ? 32 : 128;
+    unsigned int value = 0;
+    const char *digit = slash + 1;
+    if (digit == token + len)
+        return -1;
+    for (; digit < token + len; digit++) {
+        if (*digit < '0' || *digit > '9')
+            return -1;
+        value = value * 10 + (*digit - '0');
+        if (value > max_len)
+            return -1;
+    }
+    *mask_len = value;
+    return 0;
+}
+
+// Parses an AS number with optional "AS" prefix, returns 0 on success.
+static int query_parse_asn(const char *token, size_t len, uint32_t *asn)
+{
+    uint64_t value = 0;
+    if (len > 2 && (token[0] == 'A' || token[0] == 'a') &&
+        (token[1] == 'S' || token[1] == 's')) {
+        token += 2;
+        len -= 2;
+    }
+    if (len == 0 || len > 10)
+        return -1;
+    for (size_t i = 0; i < len; i++) {
+        if (token[i] < '0' || token[i] > '9')
+            return -1;
+        value = value * 10 + (token[i] - '0');
+    }
+    if (value > UINT32_MAX)
+        return -1;
+    *asn = value;
+    return 0;
+}
+
+// Returns the name of a validation state.
+static const char *query_state_str(enum pfxv_state state)
+{
+    switch (state) {
+        case BGP_PFXV_STATE_VALID:
+            return "valid";
+        case BGP_PFXV_STATE_INVALID:
+            return "invalid";
+        default:
+            return "not-found";
+    }
+}
+
+// Validates a route against the union of the VRPs of all tables: valid if
+// any table has a matching VRP, invalid if none has but one covers it.
+static int query_validate(struct pfx_table **pfx_tables, size_t pfx_tables_len,
+                          uint32_t asn, const struct lrtr_ip_addr *prefix,
+                          uint8_t mask_len, enum pfxv_state *state)
+{
+    *state = BGP_PFXV_STATE_NOT_FOUND;
+    for (size_t i = 0; i < pfx_tables_len; i++) {
+        enum pfxv_state table_state;
+        if (pfx_table_validate(pfx_tables[i], asn, prefix, mask_len,
+                               &table_state) != PFX_SUCCESS)
+            return PFX_ERROR;
+        if (table_state == BGP_PFXV_STATE_VALID) {
+            *state = BGP_PFXV_STATE_VALID;
+            break;
+        }
+        if (table_state == BGP_PFXV_STATE_INVALID)
+            *state = BGP_PFXV_STATE_INVALID;
+    }
+    return PFX_SUCCESS;
+}
+
+// Returns nonzero if the first token of `line` is the specified command.
+static int query_is_command(const char *line, const char *command)
+{
+    const char *pos = line;
+    size_t len;
+    const char *cmd = query_next_token(&pos, &len);
+    return cmd && len == strlen(command) && strncmp(cmd, command, len) == 0;
+}
+
+int query_is_query(const char *line)
+{
+    return query_is_command(line, QUERY_CMD_VALIDATE);
+}
+
+int query_is_stats(const char *line)
+{
+    return query_is_command(line, QUERY_CMD_STATS);
+}
+
+int query_answer(struct pfx_table **pfx_tables, size_t pfx_tables_len,
+                 const char *pairs, char *out, size_t out_len)
+{
+    const char *pos = pairs;
+    size_t written = 0;
+    size_t len;
+    int n;
+    // Answer every prefix/origin pair.
+    const char *prefix_token;
+    while ((prefix_token = query_next_token(&pos, &len))) {
+        const size_t prefix_len = len;
+        const char *asn_token = query_next_token(&pos, &len);
+        struct lrtr_ip_addr prefix;
+        uint8_t mask_len;
+        uint32_t asn;
+        enum pfxv_state state;
+        if (!asn_token) {
+            n = snprintf(out + written, out_len - written,
+                         "%.*s error missing origin AS\n",
+                         (int) prefix_len, prefix_token);
+        } else if (query_parse_prefix(prefix_token, prefix_len,
+                                      &prefix, &mask_len) != 0) {
+            n = snprintf(out + written, out_len - written,
+                         "%.*s %.*s error invalid prefix\n",
+                         (int) prefix_len, prefix_token, (int) len, asn_token);
+        } else if (query_parse_asn(asn_token, len, &asn) != 0) {
+            n = snprintf(out + written, out_len - written,
+                         "%.*s %.*s error invalid origin AS\n",
+                         (int) prefix_len, prefix_token, (int) len, asn_token);
+        } else if (query_validate(pfx_tables, pfx_tables_len, asn, &prefix,
+                                  mask_len, &state) != PFX_SUCCESS) {
+            n = snprintf(out + written, out_len - written,
+                         "%.*s %u error validation failed\n",
+                         (int) prefix_len, prefix_token, asn);
+        } else {
+            n = snprintf(out + written, out_len - written, "%.*s %u %s\n",
+                         (int) prefix_len, prefix_token, asn,
+                         query_state_str(state));
+        }
+        if (n < 0 || (size_t) n >= out_len - written)
+            return -1;
+        written += n;
+        if (!asn_token)
+            break;
+    }
+    // A query without any pair still gets an answer.
+    if (written == 0) {
+        n = snprintf(out, out_len, "error missing prefix\n");
+        if (n < 0 || (size_t) n >= out_len)
+            return -1;
+        written = n;
+    }
+    return written;
+}
+
+int query_handle(struct pfx_table **pfx_tables, size_t pfx_tables_len,
+                 const char *line, char *out, size_t out_len)
+{
+    const char *pos = line;
+    size_t len;
+    // Skip the command.
+    query_next_token(&pos, &len);
+    return query_answer(pfx_tables, pfx_tables_len, pos, out, out_len);
+}
+
+int query_reply(struct pfx_table **pfx_tables, size_t pfx_tables_len,
+                query_stats_fp stats, void *stats_data, const char *line,
+                char **out, size_t *out_size, size_t out_len)
+{
+    for (;;) {
+        char *pos = *out + out_len;
+        const size_t len = *out_size - out_len;
+        int n;
+        if (query_is_query(line))
+            n = query_handle(pfx_tables, pfx_tables_len, line, pos, len);
+        else if (query_is_stats(line) && stats)
+            n = stats(pos, len, stats_data);
+        else if (line[strspn(line, QUERY_DELIMITERS)] == 0)
+            n = 0;
+        else
+            n = snprintf(pos, len, "error unknown command\n");
+        if (n >= 0 && (size_t) n < len)
+            return n;
+        // Grow the buffer until the answer fits, batched validations may
+        // answer many pairs.
+        if (*out_size >= QUERY_ANSWER_MAX) {
+            n = snprintf(pos, len, "error answer too long\n");
+            return n >= 0 && (size_t) n < len ? n : -1;
+        }
+        char *grown = realloc(*out, *out_size * 2);
+        if (!grown)
+            return -1;
+        *out = grown;
+        *out_size *= 2;
+    }
+}
+
+// Serves a single client until it disconnects or the server stops. All lines
+// received with one read are answered with one write, unless the answers
+// exceed the output buffer.
+static void *query_client_thread(void *arg)
+{
+    struct query_client *client = arg;
+    const struct query_server *server = client->server;
+    const int socket = client->socket;
+    // Input and output buffers, reused for all queries of this client.
+    char *in = malloc(QUERY_BUFFER_SIZE);
+    char *out = malloc(QUERY_BUFFER_SIZE);
+    size_t out_size = QUERY_BUFFER_SIZE;
+    size_t in_len = 0;
+    // Nonzero while dropping the rest of a line exceeding the buffer.
+    int skip = 0;
+    ssize_t n;
+    while (in && out &&
+           (n = read(socket, in + in_len,
+                     QUERY_BUFFER_SIZE - 1 - in_len)) != 0) {
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        in_len += n;
+        if (skip) {
+            char *eol = memchr(in, '\n', in_len);
+            if (!eol) {
+                in_len = 0;
+                continue;
+            }
+            skip = 0;
+            in_len -= eol + 1 - in;
+            memmove(in, eol + 1, in_len);
+        }
+        size_t out_len = 0;
+        char *line = in;
+        char *eol;
+        // Answer all complete lines.
+        while ((eol = memchr(line, '\n', in + in_len - line))) {
+            *eol = 0;
+            // Flush once half of the buffer is used.
+            if (out_len >= QUERY_BUFFER_SIZE / 2) {
+                if (util_write_all(socket, out, out_len) != 0)
+                    goto done;
+                out_len = 0;
+            }
+            const int len = query_reply(server->pfx_tables,
+                                        server->pfx_tables_len, server->stats,
+                                        server->stats_data, line, &out,
+                                        &out_size, out_len);
+            if (len < 0)
+                goto done;
+            out_len += len;
+            line = eol + 1;
+        }
+        if (util_write_all(socket, out, out_len) != 0)
+            break;
+        // Keep the incomplete rest, drop lines exceeding the buffer up to
+        // their end.
+        in_len -= line - in;
+        memmove(in, line, in_len);
+        if (in_len == QUERY_BUFFER_SIZE - 1) {
+            in_len = 0;
+            skip = 1;
+            if (util_write_all(socket, "error line too long\n", 20))
+                break;
+        }
+    }
+done:
+    free(in);
+    free(out);
+    // Closed under the lock, so the server never shuts down a reused fd.
+    pthread_mutex_lock(&client->server->mutex);
+    close(socket);
+    client->socket = -1;
+    pthread_mutex_unlock(&client->server->mutex);
+    return NULL;
+}
+
+// Returns a free client slot, joining the thread of a finished client if
+// necessary, or NULL if all slots are in use. Must be called with the
+// server locked.
+static struct query_client *query_server_slot(struct query_server *server)
+{
+    struct query_client *finished = NULL;
+    for (size_t i = 0; i < QUERY_MAX_CLIENTS; i++) {
+        struct query_client *client = &server->clients[i];
+        if (!client->started)
+            return client;
+        if (client->socket < 0)
+            finished = client;
+    }
+    // The finished thread no longer needs the lock, it is about to return.
+    if (finished) {
+        pthread_join(finished->thread, NULL);
+        finished->started = 0;
+    }
+    return finished;
+}
+
+// Accepts clients and starts a thread for each of them.
+static void *query_server_thread(void *arg)
+{
+    struct query_server *server = arg;
+    int socket;
+    while ((socket = accept(server->socket, NULL, NULL)) >= 0 ||
+           errno == EINTR || errno == ECONNABORTED) {
+        if (socket < 0)
+            continue;
+        pthread_mutex_lock(&server->mutex);
+        struct query_client *client = query_server_slot(server);
+        if (!client) {
+            syslog(LOG_WARNING, "Too many query clients, rejecting");
+            close(socket);
+        } else {
+            client->server = server;
+            client->socket = socket;
+            if (pthread_create(&client->thread, NULL, query_client_thread,
+                               client) != 0) {
+                syslog(LOG_ERR, "Failed to start query client thread");
+                close(socket);
+                client->socket = -1;
+            } else {
+                client->started = 1;
+            }
+        }
+        pthread_mutex_unlock(&server->mutex);
+    }
+    return NULL;
+}
+
+int query_server_start(struct query_server *server, const char *path,
+                       struct pfx_table **pfx_tables, size_t pfx_tables_len,
+                       query_stats_fp stats, void *stats_data)
+{
+    struct sockaddr_un addr;
+    memset(server, 0, sizeof (struct query_server));
+    server->socket = -1;
+    // Check socket path length.
+    if (strlen(path) >= sizeof addr.sun_path) {
+        syslog(LOG_ERR, "Query socket path too long");
+        return -1;
+    }
+    server->socket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server->socket < 0) {
+        syslog(LOG_ERR, "Query socket creation error: %m");
+        return -1;
+    }
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    // Replace a stale socket of a previous run.
+    unlink(path);
+    if (bind(server->socket, (struct sockaddr *) &addr, sizeof addr) != 0 ||
+        listen(server->socket, QUERY_MAX_CLIENTS) != 0) {
+        syslog(LOG_ERR, "Query socket %s setup failed: %m", path);
+        close(server->socket);
+        server->socket = -1;
+        return -1;
+    }
+    server->path = strdup(path);
+    server->pfx_tables = pfx_tables;
+    server->pfx_tables_len = pfx_tables_len;
+    server->stats = stats;
+    server->stats_data = stats_data;
+    pthread_mutex_init(&server->mutex, NULL);
+    for (size_t i = 0; i < QUERY_MAX_CLIENTS; i++)
+        server->clients[i].socket = -1;
+    if (pthread_create(&server->thread, NULL, query_server_thread,
+                       server) != 0) {
+        syslog(LOG_ERR, "Failed to start query server thread");
+        close(server->socket);
+        server->socket = -1;
+        unlink(path);
+        free(server->path);
+        server->path = 0;
+        pthread_mutex_destroy(&server->mutex);
+        return -1;
+    }
+    return 0;
+}
+
+void query_server_stop(struct query_server *server)
+{
+    if (server->socket < 0)
+        return;
+    // Wakes up the accept() in the server thread.
+    shutdown(server->socket, SHUT_RDWR);
+    pthread_join(server->thread, NULL);
+    // Wakes up the clients, which may still use the prefix tables.
+    pthread_mutex_lock(&server->mutex);
+    for (size_t i = 0; i < QUERY_MAX_CLIENTS; i++) {
+        if (server->clients[i].socket >= 0)
+            shutdown(server->clients[i].socket, SHUT_RDWR);
+    }
+    pthread_mutex_unlock(&server->mutex);
+    for (size_t i = 0; i < QUERY_MAX_CLIENTS; i++) {
+        if (server->clients[i].started)
+            pthread_join(server->clients[i].thread, NULL);
+        server->clients[i].started = 0;
+    }
+    pthread_mutex_destroy(&server->mutex);
+    close(server->socket);
+    server->socket = -1;
+    unlink(server->path);
+    free(server->path);
+    server->path = 0;
+}
@@ -0,0 +1,168 @@
+/*
+ * This file is part of BIRD-RTRlib-CLI.
+ *
+ * BIRD-RTRlib-CLI is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * BIRD-RTRlib-CLI is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with BIRD-RTRlib-CLI; see the file COPYING.
+ *
+ * written by smlng and Mehmet Ceyran, in cooperation with:
+ * CST group, Freie Universitaet Berlin
+ * Website: https://github.com/rtrlib/bird-rtrlib-cli
+ */
+
+
+#ifndef BIRD_RTRLIB_CLI__QUERY_H
+#define	BIRD_RTRLIB_CLI__QUERY_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+struct pfx_table;
+
+/// Query command validating prefix/origin pairs.
+#define QUERY_CMD_VALIDATE "validate"
+/// Query command listing the metrics.
+#define QUERY_CMD_STATS "stats"
+/// Size of the per-client input and output buffers.
+#define QUERY_BUFFER_SIZE (65536)
+/// Size the output buffer may grow to for the answer of a single line.
+#define QUERY_ANSWER_MAX (16 * 1024 * 1024)
+/// Maximum number of concurrently served socket clients.
+#define QUERY_MAX_CLIENTS (64)
+
+/**
+ * Function writing the metrics as "<name> <value>" lines to `out`. Returns
+ * the number of characters written or -1 if `out` is too small.
+ */
+typedef int (*query_stats_fp)(char *out, size_t out_len, void *data);
+
+struct query_server;
+
+/**
+ * Client of the query server, served by its own thread. The slot is free
+ * again once the thread has been joined.
+ */
+struct query_client {
+    struct query_server *server;
+    // Connection, -1 once the thread has closed it.
+    int socket;
+    pthread_t thread;
+    // Nonzero while the thread has not been joined.
+    int started;
+};
+
+/**
+ * Unix socket server answering validation queries.
+ */
+struct query_server {
+    int socket;
+    char *path;
+    struct pfx_table **pfx_tables;
+    size_t pfx_tables_len;
+    query_stats_fp stats;
+    void *stats_data;
+    pthread_t thread;
+    // Protects the client sockets.
+    pthread_mutex_t mutex;
+    struct query_client clients[QUERY_MAX_CLIENTS];
+};
+
+/**
+ * Returns nonzero if the specified line is a query handled by
+ * `query_handle()`.
+ * @param line
+ * @return
+ */
+int query_is_query(const char *line);
+
+/**
+ * Returns nonzero if the specified line is the stats command.
+ * @param line
+ * @return
+ */
+int query_is_stats(const char *line);
+
+/**
+ * Validates the pairs "<prefix>/<length> <asn> [<prefix>/<length> <asn> ...]"
+ * in the specified string against the union of the prefix tables and writes
+ * one answer line "<prefix>/<length> <asn> valid|invalid|not-found" per pair
+ * to `out`. Returns the number of characters written or -1 if `out` is too
+ * small.
+ * @param pfx_tables
+ * @param pfx_tables_len
+ * @param pairs
+ * @param out
+ * @param out_len
+ * @return
+ */
+int query_answer(struct pfx_table **pfx_tables, size_t pfx_tables_len,
+                 const char *pairs, char *out, size_t out_len);
+
+/**
+ * Answers the query "validate <pairs>" in the specified line like
+ * `query_answer()`.
+ * @param pfx_tables
+ * @param pfx_tables_len
+ * @param line
+ * @param out
+ * @param out_len
+ * @return
+ */
+int query_handle(struct pfx_table **pfx_tables, size_t pfx_tables_len,
+                 const char *line, char *out, size_t out_len);
+
+/**
+ * Appends the answer of a query or stats command line to the buffer `*out`
+ * of `*out_size` bytes holding `out_len` bytes, growing it with realloc() up
+ * to `QUERY_ANSWER_MAX` bytes if the answer does not fit. Other non-empty
+ * lines get an error line, and so do answers exceeding the limit. Returns
+ * the length of the answer or -1 if the buffer could not be grown.
+ * @param pfx_tables
+ * @param pfx_tables_len
+ * @param stats
+ * @param stats_data
+ * @param line
+ * @param out
+ * @param out_size
+ * @param out_len
+ * @return
+ */
+int query_reply(struct pfx_table **pfx_tables, size_t pfx_tables_len,
+                query_stats_fp stats, void *stats_data, const char *line,
+                char **out, size_t *out_size, size_t out_len);
+
+/**
+ * Starts serving queries against the prefix tables on a Unix socket at the
+ * specified path, and the stats command with the specified function if not
+ * NULL. Every client is served by its own thread. Returns 0 on success or
+ * -1 on failure.
+ * @param server
+ * @param path
+ * @param pfx_tables
+ * @param pfx_tables_len
+ * @param stats
+ * @param stats_data
+ * @return
+ */
+int query_server_start(struct query_server *server, const char *path,
+                       struct pfx_table **pfx_tables, size_t pfx_tables_len,
+                       query_stats_fp stats, void *stats_data);
+
+/**
+ * Stops accepting new clients, disconnects all clients and waits for their
+ * threads, so the prefix tables may be freed afterwards, and removes the
+ * socket.
+ * @param server
+ */
+void query_server_stop(struct query_server *server);
+
+#endif // BIRD_RTRLIB_CLI__QUERY_H
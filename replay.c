@@ -0,0 +1,178 @@
+/*
+ * This file is part of BIRD-RTRlib-CLI.
+ *
+ * BIRD-RTRlib-CLI is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * BIRD-RTRlib-CLI is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with BIRD-RTRlib-CLI; see the file COPYING.
+ *
+ * written by smlng and Mehmet Ceyran, in cooperation with:
+ * CST group, Freie Universitaet Berlin
+ * Website: https://github.com/rtrlib/bird-rtrlib-cli
+ */
+
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+
+#include "replay.h"
+#include "util.h"
+#include <rtrlib/rtrlib.h>
+
+// Size of the stdio buffer of the recording.
+#define RECORD_BUFFER_SIZE (1024 * 1024)
+
+// File the updates are recorded to, NULL if not recording.
+static FILE *record_file = 0;
+// Monotonic clock at record_open(), in microseconds.
+static uint64_t record_origin = 0;
+// Serializes updates from concurrent RTR threads.
+static pthread_mutex_t record_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void replay_put_le(unsigned char *buffer, uint64_t value, int size)
+{
+    for (int i = 0; i < size; i++)
+        buffer[i] = value >> (8 * i);
+}
+
+static uint64_t replay_get_le(const unsigned char *buffer, int size)
+{
+    uint64_t value = 0;
+    for (int i = size - 1; i >= 0; i--)
+        value = (value << 8) | buffer[i];
+    return value;
+}
+
+void replay_encode(unsigned char *buffer, uint64_t timestamp,
+                   const struct pfx_record *record, int added)
+{
+    memset(buffer, 0, REPLAY_RECORD_SIZE);
+    replay_put_le(buffer, timestamp, 8);
+    buffer[8] = (added ? 1 : 0) | (record->prefix.ver == LRTR_IPV6 ? 2 : 0);
+    buffer[9] = record->min_len;
+    buffer[10] = record->max_len;
+    replay_put_le(buffer + 12, record->asn, 4);
+    if (record->prefix.ver == LRTR_IPV6) {
+        for (int i = 0; i < 4; i++)
+            replay_put_le(buffer + 16 + 4 * i,
+                          record->prefix.u.addr6.addr[i], 4);
+    } else {
+        replay_put_le(buffer + 16, record->prefix.u.addr4.addr, 4);
+    }
+}
+
+uint64_t replay_decode(const unsigned char *buffer, struct pfx_record *record,
+                       int *added)
+{
+    memset(record, 0, sizeof (struct pfx_record));
+    *added = buffer[8] & 1;
+    record->min_len = buffer[9];
+    record->max_len = buffer[10];
+    record->asn = replay_get_le(buffer + 12, 4);
+    if (buffer[8] & 2) {
+        record->prefix.ver = LRTR_IPV6;
+        for (int i = 0; i < 4; i++)
+            record->prefix.u.addr6.addr[i] =
+                replay_get_le(buffer + 16 + 4 * i, 4);
+    } else {
+        record->prefix.ver = LRTR_IPV4;
+        record->prefix.u.addr4.addr = replay_get_le(buffer + 16, 4);
+    }
+    return replay_get_le(buffer, 8);
+}
+
+int record_open(const char *path)
+{
+    record_file = fopen(path, "wb");
+    if (!record_file) {
+        syslog(LOG_ERR, "Failed to open record file %s: %m", path);
+        return -1;
+    }
+    setvbuf(record_file, NULL, _IOFBF, RECORD_BUFFER_SIZE);
+    if (fwrite(REPLAY_MAGIC, 1, REPLAY_MAGIC_SIZE, record_file) !=
+        REPLAY_MAGIC_SIZE) {
+        syslog(LOG_ERR, "Failed to write record file %s: %m", path);
+        fclose(record_file);
+        record_file = 0;
+        return -1;
+    }
+    record_origin = util_clock();
+    return 0;
+}
+
+void record_update(const struct pfx_record *record, int added)
+{
+    unsigned char buffer[REPLAY_RECORD_SIZE];
+    if (!record_file)
+        return;
+    pthread_mutex_lock(&record_mutex);
+    replay_encode(buffer, util_clock() - record_origin, record, added);
+    fwrite(buffer, 1, REPLAY_RECORD_SIZE, record_file);
+    pthread_mutex_unlock(&record_mutex);
+}
+
+void record_close(void)
+{
+    if (!record_file)
+        return;
+    pthread_mutex_lock(&record_mutex);
+    if (fclose(record_file) != 0)
+        syslog(LOG_ERR, "Failed to write record file: %m");
+    record_file = 0;
+    pthread_mutex_unlock(&record_mutex);
+}
+
+long replay_run(const char *path, double speed, replay_fp fp, void *data,
+                volatile int *stop)
+{
+    unsigned char buffer[REPLAY_RECORD_SIZE];
+    struct pfx_record record;
+    int added;
+    long count = 0;
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        syslog(LOG_ERR, "Failed to open replay file %s: %m", path);
+        return -1;
+    }
+    if (fread(buffer, 1, REPLAY_MAGIC_SIZE, file) != REPLAY_MAGIC_SIZE ||
+        memcmp(buffer, REPLAY_MAGIC, REPLAY_MAGIC_SIZE) != 0) {
+        syslog(LOG_ERR, "%s is not an update trace file", path);
+        fclose(file);
+        return -1;
+    }
+    const uint64_t origin = util_clock();
+    while (!*stop &&
+           fread(buffer, 1, REPLAY_RECORD_SIZE, file) == REPLAY_RECORD_SIZE) {
+        const uint64_t timestamp = replay_decode(buffer, &record, &added);
+        // Keep the recorded pace, scaled by the speed factor.
+        if (speed > 0) {
+            const uint64_t due = origin + timestamp / speed;
+            const uint64_t now = util_clock();
+            if (due > now) {
+                struct timespec delay = {
+                    (due - now) / 1000000, ((due - now) % 1000000) * 1000
+                };
+                nanosleep(&delay, NULL);
+            }
+        }
+        fp(&record, added, data);
+        count++;
+    }
+    if (ferror(file)) {
+        syslog(LOG_ERR, "Failed to read replay file %s: %m", path);
+        count = -1;
+    }
+    fclose(file);
+    return count;
+}
@@ -0,0 +1,103 @@
+/*
+ * This file is part of BIRD-RTRlib-CLI.
+ *
+ * BIRD-RTRlib-CLI is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * BIRD-RTRlib-CLI is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with BIRD-RTRlib-CLI; see the file COPYING.
+ *
+ * written by smlng and Mehmet Ceyran, in cooperation with:
+ * CST group, Freie Universitaet Berlin
+ * Website: https://github.com/rtrlib/bird-rtrlib-cli
+ */
+
+
+#ifndef BIRD_RTRLIB_CLI__REPLAY_H
+#define	BIRD_RTRLIB_CLI__REPLAY_H
+
+#include <stdint.h>
+
+/// Magic number at the start of an update trace file.
+#define REPLAY_MAGIC "BRCTRC01"
+/// Size of the magic number.
+#define REPLAY_MAGIC_SIZE (8)
+/// Size of a single encoded update in the trace file.
+#define REPLAY_RECORD_SIZE (32)
+
+struct pfx_record;
+
+/**
+ * Function called for every replayed update.
+ */
+typedef void (*replay_fp)(const struct pfx_record *record, int added,
+                          void *data);
+
+/**
+ * Encodes an update with its timestamp in microseconds into `buffer` of
+ * `REPLAY_RECORD_SIZE` bytes. The trace file consists of `REPLAY_MAGIC`
+ * followed by these records; all fields are little endian:
+ *  0: uint64 timestamp, 8: uint8 flags (1 = added, 2 = IPv6),
+ *  9: uint8 min_len, 10: uint8 max_len, 11: reserved,
+ * 12: uint32 asn, 16: 16 bytes address (IPv4 in the first 4 bytes).
+ * @param buffer
+ * @param timestamp
+ * @param record
+ * @param added
+ */
+void replay_encode(unsigned char *buffer, uint64_t timestamp,
+                   const struct pfx_record *record, int added);
+
+/**
+ * Decodes an update encoded by `replay_encode()`. Returns its timestamp.
+ * @param buffer
+ * @param record
+ * @param added
+ * @return
+ */
+uint64_t replay_decode(const unsigned char *buffer, struct pfx_record *record,
+                       int *added);
+
+/**
+ * Starts recording all updates passed to `record_update()` to the specified
+ * file. Returns 0 on success or -1 on failure.
+ * @param path
+ * @return
+ */
+int record_open(const char *path);
+
+/**
+ * Appends an update to the recording, if any. Thread safe.
+ * @param record
+ * @param added
+ */
+void record_update(const struct pfx_record *record, int added);
+
+/**
+ * Flushes and closes the recording, if any.
+ */
+void record_close(void);
+
+/**
+ * Replays the trace file at `speed` times the recorded pace, or as fast as
+ * possible if `speed` is 0, calling `fp` for every update. Stops early once
+ * `*stop` becomes nonzero. Returns the number of replayed updates or -1 on
+ * failure.
+ * @param path
+ * @param speed
+ * @param fp
+ * @param data
+ * @param stop
+ * @return
+ */
+long replay_run(const char *path, double speed, replay_fp fp, void *data,
+                volatile int *stop);
+
+#endif // BIRD_RTRLIB_CLI__REPLAY_H
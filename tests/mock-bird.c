@@ -0,0 +1,236 @@
+/*
+ * This file is part of BIRD-RTRlib-CLI.
+ *
+ * BIRD-RTRlib-CLI is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * BIRD-RTRlib-CLI is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with BIRD-RTRlib-CLI; see the file COPYING.
+ *
+ * written by smlng and Mehmet Ceyran, in cooperation with:
+ * CST group, Freie Universitaet Berlin
+ * Website: https://github.com/rtrlib/bird-rtrlib-cli
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "mock-bird.h"
+#include "util.h"
+#include <rtrlib/rtrlib.h>
+
+// Returns the i-th bit of an address, counted from the most significant.
+static int mock_bird_bit(const struct lrtr_ip_addr *addr, unsigned int i)
+{
+    if (addr->ver == LRTR_IPV4)
+        return (addr->u.addr4.addr >> (31 - i)) & 1;
+    return (addr->u.addr6.addr[i / 32] >> (31 - i % 32)) & 1;
+}
+
+// Returns nonzero if the prefix a/a_len lies within b/b_len.
+static int mock_bird_within(const struct lrtr_ip_addr *a, unsigned int a_len,
+                            const struct lrtr_ip_addr *b, unsigned int b_len)
+{
+    if (a->ver != b->ver || a_len < b_len)
+        return 0;
+    for (unsigned int i = 0; i < b_len; i++)
+        if (mock_bird_bit(a, i) != mock_bird_bit(b, i))
+            return 0;
+    return 1;
+}
+
+// Parses "<address>/<length>" at the start of the text, returns 0 on success.
+static int mock_bird_parse_prefix(const char *text, struct lrtr_ip_addr *addr,
+                                  unsigned int *len)
+{
+    char address[64];
+    return sscanf(text, "%63[^/]/%u", address, len) == 2 &&
+        lrtr_ip_str_to_addr(address, addr) == 0 ? 0 : -1;
+}
+
+// Returns the index of the ROA in the table or -1. Needs the mutex.
+static int mock_bird_find(struct mock_bird *mock, const char *roa)
+{
+    for (int i = 0; i < mock->roas_len; i++)
+        if (strcmp(mock->roas[i], roa) == 0)
+            return i;
+    return -1;
+}
+
+// Writes the ROAs within or covering the prefix of a `show roa` command.
+static void mock_bird_show(struct mock_bird *mock, int client,
+                           const char *command)
+{
+    struct lrtr_ip_addr prefix, addr;
+    unsigned int prefix_len, len;
+    const int covering = strncmp(command, "show roa for ", 13) == 0;
+    char line[MOCK_BIRD_LINE_SIZE + 8];
+    int lines = 0;
+    if (mock_bird_parse_prefix(command + 13 - !covering, &prefix,
+                               &prefix_len) != 0) {
+        util_write_all(client, "9001 Syntax error\n", 18);
+        return;
+    }
+    pthread_mutex_lock(&mock->mutex);
+    for (int i = 0; i < mock->roas_len; i++) {
+        if (mock_bird_parse_prefix(mock->roas[i], &addr, &len) != 0)
+            continue;
+        if (covering ? !mock_bird_within(&prefix, prefix_len, &addr, len) :
+            !mock_bird_within(&addr, len, &prefix, prefix_len))
+            continue;
+        const int length = snprintf(line, sizeof line, "%s%s\n",
+                                    lines++ ? " " : "1019-", mock->roas[i]);
+        util_write_all(client, line, length);
+    }
+    pthread_mutex_unlock(&mock->mutex);
+    util_write_all(client, "0000 \n", 6);
+}
+
+// Applies and records an add or delete command.
+static void mock_bird_update(struct mock_bird *mock, char *command)
+{
+    const int added = strncmp(command, "add roa ", 8) == 0;
+    char *roa = command + (added ? 8 : 11);
+    char *table = strstr(roa, " table ");
+    pthread_mutex_lock(&mock->mutex);
+    if (mock->commands_len < MOCK_BIRD_MAX_COMMANDS)
+        snprintf(mock->commands[mock->commands_len++], MOCK_BIRD_LINE_SIZE,
+                 "%s", command);
+    if (table)
+        *table = 0;
+    const int i = mock_bird_find(mock, roa);
+    if (added && i < 0 && mock->roas_len < MOCK_BIRD_MAX_ROAS) {
+        snprintf(mock->roas[mock->roas_len], MOCK_BIRD_LINE_SIZE, "%s", roa);
+        mock->roas_static[mock->roas_len++] = 0;
+    } else if (!added && i >= 0 && !mock->roas_static[i]) {
+        mock->roas_len--;
+        memcpy(mock->roas[i], mock->roas[mock->roas_len],
+               MOCK_BIRD_LINE_SIZE);
+        mock->roas_static[i] = mock->roas_static[mock->roas_len];
+    }
+    pthread_mutex_unlock(&mock->mutex);
+}
+
+// Serves one client after the other until the listening socket is shut down.
+static void *mock_bird_thread(void *arg)
+{
+    static const char greeting[] = "0001 BIRD test mock ready.\n";
+    struct mock_bird *mock = arg;
+    char line[256];
+    int client;
+    while ((client = accept(mock->socket, NULL, NULL)) >= 0) {
+        FILE *in = fdopen(dup(client), "r");
+        pthread_mutex_lock(&mock->mutex);
+        mock->client = client;
+        pthread_mutex_unlock(&mock->mutex);
+        if (in && util_write_all(client, greeting, sizeof greeting - 1) == 0) {
+            while (fgets(line, sizeof line, in)) {
+                line[strcspn(line, "\n")] = 0;
+                if (strncmp(line, "show roa ", 9) == 0) {
+                    mock_bird_show(mock, client, line);
+                    continue;
+                }
+                if (strncmp(line, "add roa ", 8) == 0 ||
+                    strncmp(line, "delete roa ", 11) == 0)
+                    mock_bird_update(mock, line);
+                if (util_write_all(client, "0000 \n", 6) != 0)
+                    break;
+            }
+        }
+        if (in)
+            fclose(in);
+        pthread_mutex_lock(&mock->mutex);
+        mock->client = -1;
+        pthread_mutex_unlock(&mock->mutex);
+        close(client);
+    }
+    return NULL;
+}
+
+int mock_bird_start(struct mock_bird *mock, const char *path)
+{
+    struct sockaddr_un addr;
+    memset(mock, 0, sizeof (struct mock_bird));
+    snprintf(mock->path, sizeof mock->path, "%s", path);
+    mock->client = -1;
+    pthread_mutex_init(&mock->mutex, NULL);
+    unlink(path);
+    mock->socket = socket(AF_UNIX, SOCK_STREAM, 0);
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof addr.sun_path, "%s", path);
+    if (mock->socket < 0 ||
+        bind(mock->socket, (struct sockaddr *) &addr, sizeof addr) != 0 ||
+        listen(mock->socket, 1) != 0) {
+        perror("mock BIRD socket");
+        return -1;
+    }
+    return pthread_create(&mock->thread, NULL, mock_bird_thread, mock) == 0 ?
+        0 : -1;
+}
+
+void mock_bird_stop(struct mock_bird *mock)
+{
+    shutdown(mock->socket, SHUT_RDWR);
+    pthread_mutex_lock(&mock->mutex);
+    if (mock->client >= 0)
+        shutdown(mock->client, SHUT_RDWR);
+    pthread_mutex_unlock(&mock->mutex);
+    pthread_join(mock->thread, NULL);
+    close(mock->socket);
+    unlink(mock->path);
+    pthread_mutex_destroy(&mock->mutex);
+}
+
+void mock_bird_put(struct mock_bird *mock, const char *roa, int is_static)
+{
+    pthread_mutex_lock(&mock->mutex);
+    if (mock_bird_find(mock, roa) < 0 && mock->roas_len < MOCK_BIRD_MAX_ROAS) {
+        snprintf(mock->roas[mock->roas_len], MOCK_BIRD_LINE_SIZE, "%s", roa);
+        mock->roas_static[mock->roas_len++] = is_static;
+    }
+    pthread_mutex_unlock(&mock->mutex);
+}
+
+int mock_bird_has(struct mock_bird *mock, const char *roa)
+{
+    pthread_mutex_lock(&mock->mutex);
+    const int has = mock_bird_find(mock, roa) >= 0;
+    pthread_mutex_unlock(&mock->mutex);
+    return has;
+}
+
+int mock_bird_count(struct mock_bird *mock, const char *command)
+{
+    int count = 0;
+    pthread_mutex_lock(&mock->mutex);
+    for (int i = 0; i < mock->commands_len; i++)
+        if (strcmp(mock->commands[i], command) == 0)
+            count++;
+    pthread_mutex_unlock(&mock->mutex);
+    return count;
+}
+
+int mock_bird_command(struct mock_bird *mock, int i, char *command)
+{
+    int ret = -1;
+    pthread_mutex_lock(&mock->mutex);
+    if (i >= 0 && i < mock->commands_len) {
+        memcpy(command, mock->commands[i], MOCK_BIRD_LINE_SIZE);
+        ret = 0;
+    }
+    pthread_mutex_unlock(&mock->mutex);
+    return ret;
+}
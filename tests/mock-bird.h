@@ -0,0 +1,104 @@
+/*
+ * This file is part of BIRD-RTRlib-CLI.
+ *
+ * BIRD-RTRlib-CLI is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * BIRD-RTRlib-CLI is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with BIRD-RTRlib-CLI; see the file COPYING.
+ *
+ * written by smlng and Mehmet Ceyran, in cooperation with:
+ * CST group, Freie Universitaet Berlin
+ * Website: https://github.com/rtrlib/bird-rtrlib-cli
+ */
+
+#ifndef BIRD_RTRLIB_CLI__TESTS__MOCK_BIRD_H
+#define	BIRD_RTRLIB_CLI__TESTS__MOCK_BIRD_H
+
+#include <pthread.h>
+
+/// Maximum number of ROAs in the table of the mock.
+#define MOCK_BIRD_MAX_ROAS (1024)
+/// Maximum number of add and delete commands recorded by the mock.
+#define MOCK_BIRD_MAX_COMMANDS (4096)
+/// Size of a ROA or command of the mock, including the terminating \0.
+#define MOCK_BIRD_LINE_SIZE (128)
+
+/**
+ * BIRD control socket served by a thread for the tests. It keeps a ROA
+ * table, "<prefix>/<length> max <max_length> as <asn>" per entry, answers
+ * `add roa`, `delete roa` and `show roa in|for` like BIRD 1.x and records the
+ * add and delete commands without the newline. Like BIRD, it silently keeps
+ * static ROAs on `delete roa`.
+ */
+struct mock_bird {
+    char path[108];
+    int socket;
+    int client;
+    char roas[MOCK_BIRD_MAX_ROAS][MOCK_BIRD_LINE_SIZE];
+    int roas_static[MOCK_BIRD_MAX_ROAS];
+    int roas_len;
+    char commands[MOCK_BIRD_MAX_COMMANDS][MOCK_BIRD_LINE_SIZE];
+    int commands_len;
+    pthread_mutex_t mutex;
+    pthread_t thread;
+};
+
+/**
+ * Starts serving a control socket at the specified path. Returns 0 on
+ * success or -1 on failure.
+ * @param mock
+ * @param path
+ * @return
+ */
+int mock_bird_start(struct mock_bird *mock, const char *path);
+
+/**
+ * Stops the mock and removes its socket. Stop the writers first.
+ * @param mock
+ */
+void mock_bird_stop(struct mock_bird *mock);
+
+/**
+ * Puts a ROA into the table behind the back of the clients, e.g., one left
+ * over from an earlier run or a static one.
+ * @param mock
+ * @param roa
+ * @param is_static
+ */
+void mock_bird_put(struct mock_bird *mock, const char *roa, int is_static);
+
+/**
+ * Returns nonzero if the table has the ROA.
+ * @param mock
+ * @param roa
+ * @return
+ */
+int mock_bird_has(struct mock_bird *mock, const char *roa);
+
+/**
+ * Returns the number of recorded commands equal to the specified one.
+ * @param mock
+ * @param command
+ * @return
+ */
+int mock_bird_count(struct mock_bird *mock, const char *command);
+
+/**
+ * Copies the i-th recorded command into the buffer of MOCK_BIRD_LINE_SIZE
+ * bytes. Returns 0 on success or -1 if there is no such command.
+ * @param mock
+ * @param i
+ * @param command
+ * @return
+ */
+int mock_bird_command(struct mock_bird *mock, int i, char *command);
+
+#endif // BIRD_RTRLIB_CLI__TESTS__MOCK_BIRD_H
@@ -0,0 +1,166 @@
+/*
+ * This file is part of BIRD-RTRlib-CLI.
+ *
+ * BIRD-RTRlib-CLI is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * BIRD-RTRlib-CLI is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with BIRD-RTRlib-CLI; see the file COPYING.
+ *
+ * written by smlng and Mehmet Ceyran, in cooperation with:
+ * CST group, Freie Universitaet Berlin
+ * Website: https://github.com/rtrlib/bird-rtrlib-cli
+ */
+
+
+/*
+ * Unit tests of the flap dampening with a deterministic clock: the suppress
+ * limit, the decay to the reuse limit, the penalty ceiling and withdrawals
+ * of held back ROAs.
+ */
+
+#include "damp.h"
+#include "test.h"
+
+/// Half-life of the tests in seconds.
+#define HALF_LIFE (100)
+
+// Counts the released ROAs.
+static void count_released(const struct pfx_record *record, void *data)
+{
+    (*(int *) data)++;
+}
+
+// Returns the number of ROAs released at the specified time.
+static int release(struct damp *damp, time_t now)
+{
+    int released = 0;
+    TEST_CHECK(damp_release(damp, now, count_released, &released) == 0);
+    return released;
+}
+
+// Announcements are held back once the penalty reaches the suppress limit.
+static void test_suppress(void)
+{
+    struct damp damp;
+    struct pfx_record record;
+    test_record(&record, "10.0.0.0/24", 24, 1);
+    damp_init(&damp, HALF_LIFE);
+    TEST_CHECK(damp_announce(&damp, &record, 0) == 1);
+    // 1000, then 1000 decayed by a 200th plus 1000 stay below 2000.
+    TEST_CHECK(damp_withdraw(&damp, &record, 0) == 1);
+    TEST_CHECK(damp_announce(&damp, &record, 0) == 1);
+    TEST_CHECK(damp_withdraw(&damp, &record, 1) == 1);
+    TEST_CHECK(damp_announce(&damp, &record, 1) == 1);
+    TEST_CHECK(!damp_is_held(&damp, &record));
+    // 1995 plus 1000 crosses it.
+    TEST_CHECK(damp_withdraw(&damp, &record, 1) == 1);
+    TEST_CHECK(damp_announce(&damp, &record, 1) == 0);
+    TEST_CHECK(damp_is_held(&damp, &record));
+    TEST_CHECK(damp.stats.flaps == 3);
+    TEST_CHECK(damp.stats.held == 1);
+    TEST_CHECK(damp.stats.suppressed == 1);
+    damp_free(&damp);
+
+    // Exactly the suppress limit holds back as well.
+    damp_init(&damp, HALF_LIFE);
+    damp_withdraw(&damp, &record, 0);
+    damp_withdraw(&damp, &record, 0);
+    TEST_CHECK(damp_announce(&damp, &record, 0) == 0);
+    damp_free(&damp);
+}
+
+// A held back ROA is released once its penalty decays below the reuse
+// limit: 2000 halves to 1000 after one half-life and falls linearly below
+// 750 after another 51 seconds.
+static void test_reuse(void)
+{
+    struct damp damp;
+    struct pfx_record record;
+    test_record(&record, "10.0.0.0/24", 24, 1);
+    damp_init(&damp, HALF_LIFE);
+    damp_withdraw(&damp, &record, 0);
+    damp_withdraw(&damp, &record, 0);
+    TEST_CHECK(damp_announce(&damp, &record, 0) == 0);
+    TEST_CHECK(release(&damp, HALF_LIFE) == 0);
+    TEST_CHECK(release(&damp, HALF_LIFE + HALF_LIFE / 2) == 0);
+    TEST_CHECK(damp_is_held(&damp, &record));
+    TEST_CHECK(release(&damp, HALF_LIFE + HALF_LIFE / 2 + 1) == 1);
+    TEST_CHECK(!damp_is_held(&damp, &record));
+    TEST_CHECK(damp.stats.released == 1);
+    TEST_CHECK(damp.stats.suppressed == 0);
+    // Released only once, and forgotten below half the reuse limit.
+    TEST_CHECK(release(&damp, 2 * HALF_LIFE) == 0);
+    TEST_CHECK(damp.stats.tracked == 1);
+    TEST_CHECK(release(&damp, 3 * HALF_LIFE) == 0);
+    TEST_CHECK(damp.stats.tracked == 0);
+    TEST_CHECK(damp_announce(&damp, &record, 3 * HALF_LIFE) == 1);
+    damp_free(&damp);
+}
+
+// However often a ROA flaps, it is held back for at most DAMP_MAX_SUPPRESS
+// half-lives after its last flap.
+static void test_ceiling(void)
+{
+    struct damp damp;
+    struct pfx_record record;
+    test_record(&record, "10.0.0.0/24", 24, 1);
+    damp_init(&damp, HALF_LIFE);
+    for (int i = 0; i < 50; i++)
+        damp_withdraw(&damp, &record, 0);
+    TEST_CHECK(damp_announce(&damp, &record, 0) == 0);
+    TEST_CHECK(release(&damp, DAMP_MAX_SUPPRESS * HALF_LIFE) == 0);
+    TEST_CHECK(release(&damp, DAMP_MAX_SUPPRESS * HALF_LIFE + 1) == 1);
+    damp_free(&damp);
+}
+
+// A ROA withdrawn while held back never reached BIRD, so neither does the
+// withdrawal, and it is not released later.
+static void test_withdraw_held(void)
+{
+    struct damp damp;
+    struct pfx_record record;
+    test_record(&record, "10.0.0.0/24", 24, 1);
+    damp_init(&damp, HALF_LIFE);
+    damp_withdraw(&damp, &record, 0);
+    damp_withdraw(&damp, &record, 0);
+    TEST_CHECK(damp_announce(&damp, &record, 0) == 0);
+    TEST_CHECK(damp_withdraw(&damp, &record, 1) == 0);
+    TEST_CHECK(!damp_is_held(&damp, &record));
+    TEST_CHECK(damp.stats.suppressed == 0);
+    TEST_CHECK(release(&damp, 10 * HALF_LIFE) == 0);
+    TEST_CHECK(damp.stats.released == 0);
+    damp_free(&damp);
+}
+
+// Without a half-life nothing is held back or tracked.
+static void test_disabled(void)
+{
+    struct damp damp;
+    struct pfx_record record;
+    test_record(&record, "10.0.0.0/24", 24, 1);
+    damp_init(&damp, 0);
+    for (int i = 0; i < 5; i++) {
+        TEST_CHECK(damp_withdraw(&damp, &record, 0) == 1);
+        TEST_CHECK(damp_announce(&damp, &record, 0) == 1);
+    }
+    TEST_CHECK(damp.stats.tracked == 0);
+    damp_free(&damp);
+}
+
+int main(void)
+{
+    test_suppress();
+    test_reuse();
+    test_ceiling();
+    test_withdraw_held();
+    test_disabled();
+    return TEST_RESULT();
+}
@@ -0,0 +1,197 @@
+/*
+ * This file is part of BIRD-RTRlib-CLI.
+ *
+ * BIRD-RTRlib-CLI is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * BIRD-RTRlib-CLI is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with BIRD-RTRlib-CLI; see the file COPYING.
+ *
+ * written by smlng and Mehmet Ceyran, in cooperation with:
+ * CST group, Freie Universitaet Berlin
+ * Website: https://github.com/rtrlib/bird-rtrlib-cli
+ */
+
+
+/*
+ * Tests of the RTR sessions merged into the ROA union, checked against the
+ * updates queued for a writer that is never started.
+ */
+
+#include <stdlib.h>
+#include <time.h>
+
+#include "config.h" // Defines bool, so it must precede rtrlib.
+#include "cache.h"
+#include "test.h"
+#include "union.h"
+#include "writer.h"
+
+// A queued update as expected by the tests.
+struct expected {
+    const char *prefix;
+    int added;
+};
+
+// Passes the updates of a prefix table to the session of the record.
+static void update_callback(struct pfx_table *table,
+                            const struct pfx_record record, const bool added)
+{
+    rtr_cache_update(rtr_cache_of(record.socket), &record, added);
+}
+
+// Sets up a session of the union with its own prefix table.
+static void cache_init(struct rtr_cache *cache, struct roa_union *roa_union,
+                       const char *host)
+{
+    rtr_cache_init(cache, roa_union, host, "323");
+    cache->pfx_table = malloc(sizeof (struct pfx_table));
+    pfx_table_init(cache->pfx_table, update_callback);
+    cache->rtr_socket.pfx_table = cache->pfx_table;
+    cache->rtr_socket.state = RTR_ESTABLISHED;
+}
+
+// Releases a session and its prefix table.
+static void cache_free(struct rtr_cache *cache)
+{
+    pfx_table_free(cache->pfx_table);
+    free(cache->pfx_table);
+    rtr_cache_free(cache);
+}
+
+// Announces or withdraws the ROA "<prefix>/<length>" in a session.
+static void announce(struct rtr_cache *cache, const char *prefix, int added)
+{
+    struct pfx_record record;
+    test_record(&record, prefix, 24, 1);
+    record.socket = &cache->rtr_socket;
+    TEST_CHECK((added ? pfx_table_add(cache->pfx_table, &record) :
+                pfx_table_remove(cache->pfx_table, &record)) == PFX_SUCCESS);
+}
+
+// Checks the updates queued for the writer, NULL ended, and clears them.
+static void check_pending(struct bird_writer *writer,
+                          const struct expected *expected)
+{
+    size_t i;
+    for (i = 0; expected[i].prefix; i++) {
+        struct pfx_record record;
+        test_record(&record, expected[i].prefix, 24, 1);
+        if (i >= writer->pending.len) {
+            fprintf(stderr, "update %zu missing, expected %s %s\n", i,
+                    expected[i].added ? "add" : "delete", expected[i].prefix);
+            test_failures++;
+            continue;
+        }
+        const struct update *update = &writer->pending.updates[i];
+        if (update->added != expected[i].added ||
+            update->record.min_len != record.min_len ||
+            !lrtr_ip_addr_equal(update->record.prefix, record.prefix)) {
+            fprintf(stderr, "update %zu differs, expected %s %s\n", i,
+                    expected[i].added ? "add" : "delete", expected[i].prefix);
+            test_failures++;
+        }
+    }
+    TEST_CHECK(writer->pending.len == i);
+    bird_writer_clear(writer);
+}
+
+// Announces and withdraws a ROA from two caches. It is added with the first
+// and deleted with the last of them.
+static void two_caches(struct roa_union *roa_union, struct bird_writer *writer)
+{
+    static struct rtr_cache a, b;
+    cache_init(&a, roa_union, "a");
+    cache_init(&b, roa_union, "b");
+    rtr_cache_status(&a.group, RTR_MGR_ESTABLISHED, &a.rtr_socket, &a);
+    rtr_cache_status(&b.group, RTR_MGR_ESTABLISHED, &b.rtr_socket, &b);
+
+    announce(&a, "10.0.0.0/16", 1);
+    announce(&b, "10.0.0.0/16", 1);
+    announce(&a, "10.0.0.0/16", 0);
+    announce(&b, "10.0.0.0/16", 0);
+    check_pending(writer, (const struct expected[]) {
+        { "10.0.0.0/16", 1 }, { "10.0.0.0/16", 0 }, { NULL, 0 } });
+
+    // At exit, only the last cache still announcing it deletes it.
+    announce(&a, "10.1.0.0/16", 1);
+    announce(&b, "10.1.0.0/16", 1);
+    announce(&b, "10.1.0.0/16", 0);
+    TEST_CHECK(rtr_cache_withdraw(&b) == 0);
+    check_pending(writer, (const struct expected[]) {
+        { "10.1.0.0/16", 1 }, { NULL, 0 } });
+    TEST_CHECK(rtr_cache_withdraw(&a) == 1);
+    check_pending(writer, (const struct expected[]) {
+        { "10.1.0.0/16", 0 }, { NULL, 0 } });
+
+    cache_free(&a);
+    cache_free(&b);
+}
+
+// Resets an established session. Nothing is sent while its socket replaces
+// the data, then the difference, adds before deletes, once RTRlib reports
+// it established, still flagged as resetting, or the socket is polled.
+static void reset(struct roa_union *roa_union, struct bird_writer *writer)
+{
+    static struct rtr_cache cache;
+    cache_init(&cache, roa_union, "c");
+    rtr_cache_status(&cache.group, RTR_MGR_ESTABLISHED, &cache.rtr_socket,
+                     &cache);
+    announce(&cache, "10.2.0.0/16", 1);
+    announce(&cache, "10.3.0.0/16", 1);
+    check_pending(writer, (const struct expected[]) {
+        { "10.2.0.0/16", 1 }, { "10.3.0.0/16", 1 }, { NULL, 0 } });
+
+    cache.rtr_socket.is_resetting = true;
+    cache.rtr_socket.state = RTR_RESET;
+    announce(&cache, "10.4.0.0/16", 1);
+    announce(&cache, "10.2.0.0/16", 0);
+    check_pending(writer, (const struct expected[]) { { NULL, 0 } });
+    rtr_cache_status(&cache.group, RTR_MGR_ESTABLISHED, &cache.rtr_socket,
+                     &cache);
+    check_pending(writer, (const struct expected[]) {
+        { "10.4.0.0/16", 1 }, { "10.2.0.0/16", 0 }, { NULL, 0 } });
+
+    // A reset without a status change ends once the socket is in sync.
+    announce(&cache, "10.5.0.0/16", 1);
+    announce(&cache, "10.3.0.0/16", 0);
+    rtr_cache_expire(&cache, time(NULL));
+    check_pending(writer, (const struct expected[]) { { NULL, 0 } });
+    cache.rtr_socket.is_resetting = false;
+    cache.rtr_socket.state = RTR_ESTABLISHED;
+    rtr_cache_expire(&cache, time(NULL));
+    check_pending(writer, (const struct expected[]) {
+        { "10.5.0.0/16", 1 }, { "10.3.0.0/16", 0 }, { NULL, 0 } });
+
+    // From then on, its updates pass again.
+    announce(&cache, "10.6.0.0/16", 1);
+    check_pending(writer, (const struct expected[]) {
+        { "10.6.0.0/16", 1 }, { NULL, 0 } });
+    rtr_cache_withdraw(&cache);
+    bird_writer_clear(writer);
+    cache_free(&cache);
+}
+
+int main(void)
+{
+    struct bird_writer writer;
+    struct roa_union roa_union;
+    TEST_CHECK(bird_writer_init(&writer, "/nonexistent", NULL, NULL,
+                                NULL) == 0);
+    roa_union_init(&roa_union, &writer, NULL, 0);
+    roa_union.writers_len = 1;
+
+    two_caches(&roa_union, &writer);
+    reset(&roa_union, &writer);
+
+    roa_union_free(&roa_union);
+    bird_writer_free(&writer);
+    return TEST_RESULT();
+}
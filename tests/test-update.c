@@ -0,0 +1,127 @@
+/*
+ * This file is part of BIRD-RTRlib-CLI.
+ *
+ * BIRD-RTRlib-CLI is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * BIRD-RTRlib-CLI is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with BIRD-RTRlib-CLI; see the file COPYING.
+ *
+ * written by smlng and Mehmet Ceyran, in cooperation with:
+ * CST group, Freie Universitaet Berlin
+ * Website: https://github.com/rtrlib/bird-rtrlib-cli
+ */
+
+
+/*
+ * Unit tests of update_batch_sort(): the order of the sorted batch and the
+ * coalescing of several updates of the same ROA into its final state.
+ */
+
+#include <string.h>
+
+#include "test.h"
+#include "update.h"
+
+// Formats an update like the BIRD command it becomes, without the table.
+static void format_update(const struct update *update, char *text,
+                          size_t size)
+{
+    char address[64];
+    lrtr_ip_addr_to_str(&update->record.prefix, address, sizeof address);
+    snprintf(text, size, "%s roa %s/%u max %u as %u",
+             update->added ? "add" : "delete", address,
+             update->record.min_len, update->record.max_len,
+             update->record.asn);
+}
+
+// Appends an update of the ROA "<prefix>/<length>" with max length 24.
+static void add(struct update_batch *batch, const char *prefix, uint32_t asn,
+                int added)
+{
+    struct pfx_record record;
+    test_record(&record, prefix, 24, asn);
+    update_batch_add(batch, &record, added);
+}
+
+// Sorts the batch and checks it against the expected commands, NULL ended.
+static void check_sorted(struct update_batch *batch, const char **expected)
+{
+    char text[128];
+    size_t len = 0;
+    TEST_CHECK(update_batch_sort(batch) == 0);
+    while (expected[len])
+        len++;
+    TEST_CHECK(batch->len == len);
+    for (size_t i = 0; i < batch->len && i < len; i++) {
+        format_update(&batch->updates[i], text, sizeof text);
+        if (strcmp(text, expected[i]) != 0) {
+            fprintf(stderr, "update %zu is '%s', expected '%s'\n", i, text,
+                    expected[i]);
+            test_failures++;
+        }
+    }
+    batch->len = 0;
+}
+
+int main(void)
+{
+    struct update_batch batch;
+    update_batch_init(&batch);
+
+    // A ROA added and deleted within the batch was not in BIRD before.
+    add(&batch, "10.0.1.0/24", 1, 1);
+    add(&batch, "10.0.1.0/24", 1, 0);
+    add(&batch, "10.0.0.0/24", 1, 1);
+    check_sorted(&batch, (const char *[]) {
+        "add roa 10.0.0.0/24 max 24 as 1", NULL });
+
+    // A ROA deleted and added again within the batch ends up added.
+    add(&batch, "10.0.1.0/24", 1, 0);
+    add(&batch, "10.0.1.0/24", 1, 1);
+    check_sorted(&batch, (const char *[]) {
+        "add roa 10.0.1.0/24 max 24 as 1", NULL });
+
+    // Repeated adds collapse into one, a delete, add and delete into the
+    // delete.
+    add(&batch, "10.0.2.0/24", 1, 1);
+    add(&batch, "10.0.3.0/24", 1, 0);
+    add(&batch, "10.0.2.0/24", 1, 1);
+    add(&batch, "10.0.3.0/24", 1, 1);
+    add(&batch, "10.0.2.0/24", 1, 1);
+    add(&batch, "10.0.3.0/24", 1, 0);
+    check_sorted(&batch, (const char *[]) {
+        "add roa 10.0.2.0/24 max 24 as 1",
+        "delete roa 10.0.3.0/24 max 24 as 1", NULL });
+
+    // An add, delete and add again is an add of a ROA BIRD did not have.
+    add(&batch, "10.0.4.0/24", 1, 1);
+    add(&batch, "10.0.4.0/24", 1, 0);
+    add(&batch, "10.0.4.0/24", 1, 1);
+    check_sorted(&batch, (const char *[]) {
+        "add roa 10.0.4.0/24 max 24 as 1", NULL });
+
+    // Order by family, address, lengths and origin AS; ROAs differing only
+    // in the origin AS are not coalesced.
+    add(&batch, "2001:db8::/24", 1, 1);
+    add(&batch, "10.0.0.0/24", 2, 1);
+    add(&batch, "9.0.0.0/24", 3, 0);
+    add(&batch, "10.0.0.0/24", 1, 1);
+    add(&batch, "10.0.0.0/16", 1, 1);
+    check_sorted(&batch, (const char *[]) {
+        "delete roa 9.0.0.0/24 max 24 as 3",
+        "add roa 10.0.0.0/16 max 24 as 1",
+        "add roa 10.0.0.0/24 max 24 as 1",
+        "add roa 10.0.0.0/24 max 24 as 2",
+        "add roa 2001:db8::/24 max 24 as 1", NULL });
+
+    update_batch_free(&batch);
+    return TEST_RESULT();
+}
@@ -0,0 +1,176 @@
+/*
+ * This file is part of BIRD-RTRlib-CLI.
+ *
+ * BIRD-RTRlib-CLI is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * BIRD-RTRlib-CLI is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with BIRD-RTRlib-CLI; see the file COPYING.
+ *
+ * written by smlng and Mehmet Ceyran, in cooperation with:
+ * CST group, Freie Universitaet Berlin
+ * Website: https://github.com/rtrlib/bird-rtrlib-cli
+ */
+
+
+/*
+ * Tests of the BIRD writer against the mock BIRD control socket.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "mock-bird.h"
+#include "test.h"
+#include "writer.h"
+
+// Directory of the mock BIRD socket and its path.
+static char test_dir[] = "/tmp/bird-rtrlib-cli-test.XXXXXX";
+static char test_socket[sizeof test_dir + 16];
+
+// Queues an update of the ROA "<prefix>/<length>" with max length 24.
+static void enqueue(struct bird_writer *writer, const char *prefix,
+                    int added)
+{
+    struct pfx_record record;
+    test_record(&record, prefix, 24, 1);
+    bird_writer_enqueue(writer, &record, added);
+}
+
+// Checks the commands BIRD got against the expected ones, NULL ended.
+static void check_commands(struct mock_bird *mock, const char **expected)
+{
+    char command[MOCK_BIRD_LINE_SIZE];
+    int i;
+    for (i = 0; expected[i]; i++) {
+        if (mock_bird_command(mock, i, command) != 0) {
+            fprintf(stderr, "command %d missing, expected '%s'\n", i,
+                    expected[i]);
+            test_failures++;
+        } else if (strcmp(command, expected[i]) != 0) {
+            fprintf(stderr, "command %d is '%s', expected '%s'\n", i, command,
+                    expected[i]);
+            test_failures++;
+        }
+    }
+    TEST_CHECK(mock_bird_command(mock, i, command) != 0);
+}
+
+// Sends a batch of `count` updates, queued before the writer connects so
+// that it takes them at once, with a sort threshold of 4. The batch adds
+// and deletes 10.0.1.0/24 and adds 10.0.0.0/24 and further ROAs.
+static void send_batch(struct mock_bird *mock, int count)
+{
+    struct bird_writer writer;
+    static const char *prefixes[] = { "10.0.3.0/24", "10.0.2.0/24" };
+    volatile int stop = 0;
+    TEST_CHECK(mock_bird_start(mock, test_socket) == 0);
+    TEST_CHECK(bird_writer_init(&writer, test_socket, NULL, NULL, NULL) == 0);
+    writer.quiet = 1;
+    writer.sort_threshold = 4;
+    enqueue(&writer, "10.0.1.0/24", 1);
+    enqueue(&writer, "10.0.1.0/24", 0);
+    enqueue(&writer, "10.0.0.0/24", 1);
+    for (int i = 3; i < count; i++)
+        enqueue(&writer, prefixes[i - 3], 1);
+    TEST_CHECK(bird_writer_start(&writer) == 0);
+    bird_writer_wait_idle(&writer, &stop);
+    bird_writer_stop(&writer);
+    bird_writer_free(&writer);
+    mock_bird_stop(mock);
+}
+
+// Expects the ROA 0.3.0.0/16-24 AS 1 in the first audit chunk, 0.0.0.0/8,
+// and skips all other chunks, so that the writer audits it every interval.
+static int expect_first_chunk(struct bird_writer *writer,
+                              const struct lrtr_ip_addr *prefix,
+                              uint8_t prefix_len, struct update_batch *batch,
+                              void *data)
+{
+    struct pfx_record record;
+    if (prefix->ver != LRTR_IPV4 || prefix->u.addr4.addr != 0 ||
+        prefix_len != 8)
+        return -1;
+    test_record(&record, "0.3.0.0/16", 24, 1);
+    update_batch_add(batch, &record, 1);
+    return 0;
+}
+
+// Audits a BIRD table with a stale ROA of an earlier run, a static ROA and
+// a missing one. The stale ROA is deleted and the missing one added, the
+// static one survives its delete and is left alone from then on.
+static void audit(struct mock_bird *mock)
+{
+    struct bird_writer writer;
+    struct bird_writer_stats stats;
+    TEST_CHECK(mock_bird_start(mock, test_socket) == 0);
+    mock_bird_put(mock, "0.1.0.0/16 max 16 as 64496", 0);
+    mock_bird_put(mock, "0.2.0.0/16 max 16 as 64497", 1);
+    TEST_CHECK(bird_writer_init(&writer, test_socket, NULL, NULL, NULL) == 0);
+    writer.quiet = 1;
+    writer.expect = expect_first_chunk;
+    writer.audit_interval = 1;
+    bird_writer_sync_done(&writer);
+    TEST_CHECK(bird_writer_start(&writer) == 0);
+    // The chunk is audited after one, two and three seconds.
+    for (int i = 0; i < 100; i++) {
+        bird_writer_get_stats(&writer, &stats);
+        if (stats.audit_chunks >= 3)
+            break;
+        usleep(100000);
+    }
+    bird_writer_stop(&writer);
+    bird_writer_free(&writer);
+    mock_bird_stop(mock);
+    TEST_CHECK(stats.audit_chunks >= 3);
+    TEST_CHECK(!mock_bird_has(mock, "0.1.0.0/16 max 16 as 64496"));
+    TEST_CHECK(mock_bird_has(mock, "0.2.0.0/16 max 16 as 64497"));
+    TEST_CHECK(mock_bird_has(mock, "0.3.0.0/16 max 24 as 1"));
+    TEST_CHECK(mock_bird_count(mock,
+                               "delete roa 0.1.0.0/16 max 16 as 64496") == 1);
+    TEST_CHECK(mock_bird_count(mock,
+                               "delete roa 0.2.0.0/16 max 16 as 64497") == 1);
+    TEST_CHECK(mock_bird_count(mock, "add roa 0.3.0.0/16 max 24 as 1") == 1);
+    TEST_CHECK(stats.audit_missing == 1);
+    TEST_CHECK(stats.audit_extra == 2);
+    TEST_CHECK(stats.audit_foreign >= 1);
+}
+
+int main(void)
+{
+    static struct mock_bird mock;
+    if (!mkdtemp(test_dir))
+        return 2;
+    snprintf(test_socket, sizeof test_socket, "%s/bird.ctl", test_dir);
+
+    // Below the sort threshold, the updates are sent as queued.
+    send_batch(&mock, 3);
+    check_commands(&mock, (const char *[]) {
+        "add roa 10.0.1.0/24 max 24 as 1",
+        "delete roa 10.0.1.0/24 max 24 as 1",
+        "add roa 10.0.0.0/24 max 24 as 1", NULL });
+
+    // At and above it, they are sorted and the add and delete cancel out.
+    send_batch(&mock, 4);
+    check_commands(&mock, (const char *[]) {
+        "add roa 10.0.0.0/24 max 24 as 1",
+        "add roa 10.0.3.0/24 max 24 as 1", NULL });
+    send_batch(&mock, 5);
+    check_commands(&mock, (const char *[]) {
+        "add roa 10.0.0.0/24 max 24 as 1",
+        "add roa 10.0.2.0/24 max 24 as 1",
+        "add roa 10.0.3.0/24 max 24 as 1", NULL });
+
+    audit(&mock);
+
+    rmdir(test_dir);
+    return TEST_RESULT();
+}
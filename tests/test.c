@@ -0,0 +1,44 @@
+/*
+ * This file is part of BIRD-RTRlib-CLI.
+ *
+ * BIRD-RTRlib-CLI is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * BIRD-RTRlib-CLI is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with BIRD-RTRlib-CLI; see the file COPYING.
+ *
+ * written by smlng and Mehmet Ceyran, in cooperation with:
+ * CST group, Freie Universitaet Berlin
+ * Website: https://github.com/rtrlib/bird-rtrlib-cli
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+
+int test_failures = 0;
+
+void test_record(struct pfx_record *record, const char *prefix,
+                 uint8_t max_len, uint32_t asn)
+{
+    char address[64];
+    unsigned int len = 0;
+    memset(record, 0, sizeof (struct pfx_record));
+    if (sscanf(prefix, "%63[^/]/%u", address, &len) != 2 ||
+        lrtr_ip_str_to_addr(address, &record->prefix) != 0) {
+        fprintf(stderr, "bad test prefix %s\n", prefix);
+        exit(2);
+    }
+    record->min_len = len;
+    record->max_len = max_len;
+    record->asn = asn;
+}
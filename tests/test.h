@@ -0,0 +1,56 @@
+/*
+ * This file is part of BIRD-RTRlib-CLI.
+ *
+ * BIRD-RTRlib-CLI is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * BIRD-RTRlib-CLI is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with BIRD-RTRlib-CLI; see the file COPYING.
+ *
+ * written by smlng and Mehmet Ceyran, in cooperation with:
+ * CST group, Freie Universitaet Berlin
+ * Website: https://github.com/rtrlib/bird-rtrlib-cli
+ */
+
+#ifndef BIRD_RTRLIB_CLI__TESTS__TEST_H
+#define	BIRD_RTRLIB_CLI__TESTS__TEST_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <rtrlib/rtrlib.h>
+
+/// Number of failed checks of the test program.
+extern int test_failures;
+
+/// Reports a failed check with its location and counts it, the test goes on.
+#define TEST_CHECK(condition) do { \
+    if (!(condition)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+                #condition); \
+        test_failures++; \
+    } \
+} while (0)
+
+/// Exit status of the test program.
+#define TEST_RESULT() (test_failures ? 1 : 0)
+
+/**
+ * Sets up a record for the ROA "<address>/<length>" with the specified
+ * maximum length and origin AS.
+ * @param record
+ * @param prefix
+ * @param max_len
+ * @param asn
+ */
+void test_record(struct pfx_record *record, const char *prefix,
+                 uint8_t max_len, uint32_t asn);
+
+#endif // BIRD_RTRLIB_CLI__TESTS__TEST_H
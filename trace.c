@@ -0,0 +1,243 @@
+/*
+ * This file is part of BIRD-RTRlib-CLI.
+ *
+ * BIRD-RTRlib-CLI is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * BIRD-RTRlib-CLI is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with BIRD-RTRlib-CLI; see the file COPYING.
+ *
+ * written by smlng and Mehmet Ceyran, in cooperation with:
+ * CST group, Freie Universitaet Berlin
+ * Website: https://github.com/rtrlib/bird-rtrlib-cli
+ */
+
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <unistd.h>
+
+#include "trace.h"
+#include "util.h"
+
+// A recorded time span.
+struct trace_event {
+    const char *name;
+    uint64_t begin;
+    uint64_t end;
+};
+
+// Names of the startup phases as they appear in the trace.
+static const char *trace_phase_names[TRACE_PHASE_MAX] = {
+    "bird_connect",
+    "transport_init",
+    "rtr_mgr_start",
+    "first_pdu",
+    "initial_sync",
+    "bird_load"
+};
+
+// Path of the trace file, NULL if tracing is disabled.
+static char *trace_path = 0;
+// Keep one out of this many sampled spans.
+static unsigned int trace_sample_rate = 1;
+// Number of calls to trace_sample().
+static unsigned long trace_sample_count = 0;
+// Monotonic clock at trace_init(), in microseconds.
+static uint64_t trace_origin = 0;
+// Startup phases, zero timestamps mean not (yet) reached.
+static struct trace_event trace_phases[TRACE_PHASE_MAX];
+// Time of the latest BIRD acknowledgement.
+static uint64_t trace_last_ack = 0;
+// Ring buffer of sampled spans.
+static struct trace_event *trace_spans = 0;
+// Total number of spans stored in the ring buffer.
+static unsigned long trace_spans_count = 0;
+// Protects all of the above against concurrent RTR threads.
+static pthread_mutex_t trace_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Returns an allocated absolute path of the file at `path`, resolving its
+// directory, which must exist, against the current working directory.
+static char *trace_absolute_path(const char *path)
+{
+    char dir[PATH_MAX];
+    const char *slash = strrchr(path, '/');
+    const char *name = slash ? slash + 1 : path;
+    if (path[0] == '/')
+        return strdup(path);
+    if (!slash)
+        strcpy(dir, ".");
+    else if ((size_t) (slash - path) < sizeof dir)
+        snprintf(dir, sizeof dir, "%.*s", (int) (slash - path), path);
+    else
+        return NULL;
+    char *real = realpath(dir, NULL);
+    if (!real)
+        return NULL;
+    char *absolute = malloc(strlen(real) + strlen(name) + 2);
+    if (absolute)
+        sprintf(absolute, "%s/%s", real, name);
+    free(real);
+    return absolute;
+}
+
+int trace_init(const char *path, unsigned int sample_rate)
+{
+    // The daemon changes to "/", relative paths would end up there.
+    trace_path = trace_absolute_path(path);
+    if (!trace_path) {
+        syslog(LOG_ERR, "Failed to resolve trace file %s: %m", path);
+        return -1;
+    }
+    trace_spans = calloc(TRACE_BUFFER_SIZE, sizeof (struct trace_event));
+    if (!trace_spans) {
+        syslog(LOG_ERR, "Failed to allocate trace buffer");
+        free(trace_path);
+        trace_path = 0;
+        return -1;
+    }
+    trace_sample_rate = sample_rate ? sample_rate : 1;
+    trace_origin = util_clock();
+    return 0;
+}
+
+void trace_free(void)
+{
+    free(trace_spans);
+    trace_spans = 0;
+    free(trace_path);
+    trace_path = 0;
+}
+
+uint64_t trace_now(void)
+{
+    // Never return 0, it marks unset timestamps.
+    return util_clock() - trace_origin + 1;
+}
+
+void trace_phase_begin(enum trace_phase phase)
+{
+    if (!trace_path)
+        return;
+    pthread_mutex_lock(&trace_mutex);
+    if (!trace_phases[phase].begin)
+        trace_phases[phase].begin = trace_now();
+    pthread_mutex_unlock(&trace_mutex);
+}
+
+void trace_phase_end(enum trace_phase phase)
+{
+    if (!trace_path)
+        return;
+    pthread_mutex_lock(&trace_mutex);
+    if (trace_phases[phase].begin && !trace_phases[phase].end)
+        trace_phases[phase].end = trace_now();
+    pthread_mutex_unlock(&trace_mutex);
+}
+
+void trace_bird_ack(void)
+{
+    if (!trace_path)
+        return;
+    pthread_mutex_lock(&trace_mutex);
+    trace_last_ack = trace_now();
+    pthread_mutex_unlock(&trace_mutex);
+}
+
+void trace_bird_load_done(void)
+{
+    if (!trace_path)
+        return;
+    pthread_mutex_lock(&trace_mutex);
+    struct trace_event *load = &trace_phases[TRACE_PHASE_BIRD_LOAD];
+    if (load->begin && !load->end)
+        load->end = trace_last_ack > load->begin ? trace_last_ack : load->begin;
+    pthread_mutex_unlock(&trace_mutex);
+}
+
+int trace_sample(void)
+{
+    if (!trace_path)
+        return 0;
+    return __sync_fetch_and_add(&trace_sample_count, 1) % trace_sample_rate == 0;
+}
+
+void trace_span(const char *name, uint64_t begin, uint64_t end)
+{
+    if (!trace_path)
+        return;
+    pthread_mutex_lock(&trace_mutex);
+    struct trace_event *event =
+        &trace_spans[trace_spans_count++ % TRACE_BUFFER_SIZE];
+    event->name = name;
+    event->begin = begin;
+    event->end = end;
+    pthread_mutex_unlock(&trace_mutex);
+}
+
+// Writes a single complete event ("ph":"X") to the trace file.
+static void trace_write_event(FILE *file, const char *cat, int tid,
+                              const struct trace_event *event, int *first)
+{
+    fprintf(file,
+            "%s\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\","
+            "\"ts\":%llu,\"dur\":%llu,\"pid\":%d,\"tid\":%d}",
+            *first ? "" : ",",
+            event->name,
+            cat,
+            (unsigned long long) event->begin,
+            (unsigned long long) (event->end - event->begin),
+            (int) getpid(),
+            tid);
+    *first = 0;
+}
+
+int trace_write(void)
+{
+    if (!trace_path)
+        return 0;
+    // Also serializes concurrent writes of the file.
+    pthread_mutex_lock(&trace_mutex);
+    FILE *file = fopen(trace_path, "w");
+    if (!file) {
+        syslog(LOG_ERR, "Failed to open trace file %s: %m", trace_path);
+        pthread_mutex_unlock(&trace_mutex);
+        return -1;
+    }
+    int first = 1;
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    // Phases on the first track, only those that have begun.
+    for (int i = 0; i < TRACE_PHASE_MAX; i++) {
+        struct trace_event event = trace_phases[i];
+        if (!event.begin)
+            continue;
+        event.name = trace_phase_names[i];
+        // Still running phases end now.
+        if (!event.end)
+            event.end = trace_now();
+        trace_write_event(file, "phase", 1, &event, &first);
+    }
+    // Sampled spans on the second track, oldest first.
+    unsigned long start = trace_spans_count > TRACE_BUFFER_SIZE ?
+        trace_spans_count - TRACE_BUFFER_SIZE : 0;
+    for (unsigned long i = start; i < trace_spans_count; i++)
+        trace_write_event(file, "sample", 2,
+                          &trace_spans[i % TRACE_BUFFER_SIZE], &first);
+    fprintf(file, "\n]}\n");
+    const int ret = fclose(file);
+    if (ret != 0)
+        syslog(LOG_ERR, "Failed to write trace file %s: %m", trace_path);
+    pthread_mutex_unlock(&trace_mutex);
+    return ret != 0 ? -1 : 0;
+}
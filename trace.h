@@ -0,0 +1,111 @@
+/*
+ * This file is part of BIRD-RTRlib-CLI.
+ *
+ * BIRD-RTRlib-CLI is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * BIRD-RTRlib-CLI is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with BIRD-RTRlib-CLI; see the file COPYING.
+ *
+ * written by smlng and Mehmet Ceyran, in cooperation with:
+ * CST group, Freie Universitaet Berlin
+ * Website: https://github.com/rtrlib/bird-rtrlib-cli
+ */
+
+
+#ifndef BIRD_RTRLIB_CLI__TRACE_H
+#define	BIRD_RTRLIB_CLI__TRACE_H
+
+#include <stdint.h>
+
+/// Size of the ring buffer holding sampled spans.
+#define TRACE_BUFFER_SIZE (4096)
+
+/// Startup phases recorded by the tracer.
+enum trace_phase {
+    TRACE_PHASE_BIRD_CONNECT, // Connecting to the BIRD control socket
+    TRACE_PHASE_TRANSPORT_INIT, // Setting up the RTR transport and manager
+    TRACE_PHASE_RTR_MGR_START, // Starting the RTR manager
+    TRACE_PHASE_FIRST_PDU, // Waiting for the first prefix update
+    TRACE_PHASE_INITIAL_SYNC, // Receiving the initial dump from the cache
+    TRACE_PHASE_BIRD_LOAD, // Loading the initial dump into BIRD
+    TRACE_PHASE_MAX
+};
+
+/**
+ * Enables the tracer. The trace is written to the specified file by
+ * `trace_write()`, a relative path is resolved against the current working
+ * directory now; one out of `sample_rate` spans passed to `trace_sample()`
+ * is kept. Returns 0 on success or -1 on failure.
+ * @param path
+ * @param sample_rate
+ * @return
+ */
+int trace_init(const char *path, unsigned int sample_rate);
+
+/**
+ * Releases the tracer resources.
+ */
+void trace_free(void);
+
+/**
+ * Returns the current time in microseconds since `trace_init()`.
+ * @return
+ */
+uint64_t trace_now(void);
+
+/**
+ * Marks the begin of the specified phase. Only the first call per phase
+ * has an effect.
+ * @param phase
+ */
+void trace_phase_begin(enum trace_phase phase);
+
+/**
+ * Marks the end of the specified phase. Only the first call per phase
+ * has an effect.
+ * @param phase
+ */
+void trace_phase_end(enum trace_phase phase);
+
+/**
+ * Records the time of the latest acknowledgement received from BIRD.
+ */
+void trace_bird_ack(void);
+
+/**
+ * Ends the BIRD load phase at the time of the latest BIRD acknowledgement.
+ */
+void trace_bird_load_done(void);
+
+/**
+ * Returns nonzero if the next span should be recorded. Always returns 0 if
+ * the tracer is disabled.
+ * @return
+ */
+int trace_sample(void);
+
+/**
+ * Stores a sampled span in the ring buffer, overwriting the oldest span if
+ * the buffer is full.
+ * @param name
+ * @param begin
+ * @param end
+ */
+void trace_span(const char *name, uint64_t begin, uint64_t end);
+
+/**
+ * Writes all recorded phases and spans in Chrome trace event format to the
+ * configured file. Returns 0 on success or -1 on failure.
+ * @return
+ */
+int trace_write(void);
+
+#endif // BIRD_RTRLIB_CLI__TRACE_H
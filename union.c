@@ -0,0 +1,226 @@
+/*
+ * This file is part of BIRD-RTRlib-CLI.
+ *
+ * BIRD-RTRlib-CLI is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * BIRD-RTRlib-CLI is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with BIRD-RTRlib-CLI; see the file COPYING.
+ *
+ * written by smlng and Mehmet Ceyran, in cooperation with:
+ * CST group, Freie Universitaet Berlin
+ * Website: https://github.com/rtrlib/bird-rtrlib-cli
+ */
+
+
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+
+#include "config.h"
+#include "union.h"
+#include "util.h"
+#include <rtrlib/rtrlib.h>
+
+// The reference count of a ROA in the union counts caches in one byte.
+_Static_assert(CONFIG_MAX_RTR_SERVERS < UINT8_MAX,
+               "the ROA union counts the caches of a ROA in a byte");
+
+// Batch filled from the ROA union.
+struct roa_union_batch {
+    struct roa_union *roa_union;
+    struct update_batch *batch;
+};
+
+void roa_union_init(struct roa_union *roa_union, struct bird_writer *writers,
+                    const char *ip_version, unsigned int half_life)
+{
+    memset(roa_union, 0, sizeof (struct roa_union));
+    vrp_store_init(&roa_union->store, sizeof (uint8_t));
+    pthread_mutex_init(&roa_union->mutex, NULL);
+    pthread_cond_init(&roa_union->damp_cond, NULL);
+    damp_init(&roa_union->damp, half_life);
+    roa_union->writers = writers;
+    roa_union->ip_version = ip_version;
+}
+
+void roa_union_free(struct roa_union *roa_union)
+{
+    vrp_store_free(&roa_union->store);
+    damp_free(&roa_union->damp);
+    pthread_mutex_destroy(&roa_union->mutex);
+    pthread_cond_destroy(&roa_union->damp_cond);
+}
+
+int roa_union_allowed(const struct roa_union *roa_union,
+                      const struct pfx_record *record)
+{
+    if (!roa_union->ip_version)
+        return 1;
+    if (record->prefix.ver == LRTR_IPV4)
+        return strchr(roa_union->ip_version, '4') != NULL;
+    return strchr(roa_union->ip_version, '6') != NULL;
+}
+
+void roa_union_send(struct roa_union *roa_union,
+                    const struct pfx_record *record, int added)
+{
+    for (size_t i = 0; i < roa_union->writers_len; i++)
+        bird_writer_enqueue(&roa_union->writers[i], record, added);
+}
+
+/**
+ * Returns a monotonic timestamp in seconds for the flap dampening.
+ * @return
+ */
+static time_t roa_union_clock(void)
+{
+    return util_clock() / 1000000;
+}
+
+void roa_union_update(struct roa_union *roa_union,
+                      const struct pfx_record *record, int added)
+{
+    uint8_t *count;
+    int changed = 1;
+    pthread_mutex_lock(&roa_union->mutex);
+    if (added) {
+        if (vrp_store_add(&roa_union->store, record, (void **) &count) < 0) {
+            syslog(LOG_ERR, "Failed to add ROA to the union");
+        } else if (*count == UINT8_MAX) {
+            // Cannot happen with at most CONFIG_MAX_RTR_SERVERS caches that
+            // announce a ROA once each, but never wrap around to 0.
+            syslog(LOG_ERR, "Too many announcements of a ROA in the union");
+            changed = 0;
+        } else {
+            changed = ++*count == 1;
+        }
+    } else if (vrp_store_find(&roa_union->store, record,
+                              (void **) &count) != 1 || --*count > 0) {
+        changed = 0;
+    } else {
+        vrp_store_remove(&roa_union->store, record);
+    }
+    // Withdrawals always pass the dampening, announcements may be held.
+    if (changed)
+        changed = added ?
+            damp_announce(&roa_union->damp, record, roa_union_clock()) :
+            damp_withdraw(&roa_union->damp, record, roa_union_clock());
+    // Queue while holding the union, so BIRD sees the changes in order.
+    if (changed)
+        roa_union_send(roa_union, record, added);
+    pthread_mutex_unlock(&roa_union->mutex);
+}
+
+/**
+ * Callback for releasing ROAs held back by the dampening, sends them.
+ * @param record
+ * @param data
+ */
+static void roa_union_release_callback(const struct pfx_record *record,
+                                       void *data)
+{
+    roa_union_send(data, record, 1);
+}
+
+/**
+ * Thread releasing the ROAs held back by the dampening once their penalty
+ * has decayed, checks once per second.
+ * @param arg
+ * @return
+ */
+static void *roa_union_damp_thread(void *arg)
+{
+    struct roa_union *roa_union = arg;
+    pthread_mutex_lock(&roa_union->mutex);
+    while (!roa_union->damp_stop) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += 1;
+        pthread_cond_timedwait(&roa_union->damp_cond, &roa_union->mutex,
+                               &deadline);
+        if (damp_release(&roa_union->damp, roa_union_clock(),
+                         roa_union_release_callback, roa_union) != 0)
+            syslog(LOG_ERR, "Failed to release dampened ROAs");
+    }
+    pthread_mutex_unlock(&roa_union->mutex);
+    return NULL;
+}
+
+/**
+ * Callback for iterating the ROA union, adds the records to a batch except
+ * the ones held back by the dampening.
+ * @param record
+ * @param value
+ * @param data
+ */
+static void roa_union_batch_callback(const struct pfx_record *record,
+                                     void *value, void *data)
+{
+    struct roa_union_batch *load = data;
+    if (damp_is_held(&load->roa_union->damp, record))
+        return;
+    if (update_batch_add(load->batch, record, 1) != 0)
+        syslog(LOG_ERR, "Failed to queue BIRD update");
+}
+
+void roa_union_load(struct bird_writer *writer, struct update_batch *batch,
+                    void *data)
+{
+    struct roa_union *roa_union = data;
+    struct roa_union_batch load = {roa_union, batch};
+    pthread_mutex_lock(&roa_union->mutex);
+    // Queued updates are already part of the union.
+    bird_writer_clear(writer);
+    vrp_store_for_each(&roa_union->store, roa_union_batch_callback, &load);
+    pthread_mutex_unlock(&roa_union->mutex);
+}
+
+int roa_union_expect(struct bird_writer *writer,
+                     const struct lrtr_ip_addr *prefix, uint8_t prefix_len,
+                     struct update_batch *batch, void *data)
+{
+    struct roa_union *roa_union = data;
+    struct roa_union_batch expected = {roa_union, batch};
+    struct pfx_record probe;
+    probe.prefix = *prefix;
+    if (!roa_union_allowed(roa_union, &probe))
+        return -1;
+    pthread_mutex_lock(&roa_union->mutex);
+    vrp_store_for_each_in(&roa_union->store, prefix, prefix_len,
+                          roa_union_batch_callback, &expected);
+    vrp_store_for_each_at(&roa_union->store, prefix, prefix_len,
+                          roa_union_batch_callback, &expected);
+    pthread_mutex_unlock(&roa_union->mutex);
+    return 0;
+}
+
+int roa_union_start_damping(struct roa_union *roa_union)
+{
+    if (!roa_union->damp.half_life)
+        return 0;
+    if (pthread_create(&roa_union->damp_thread, NULL, roa_union_damp_thread,
+                       roa_union) != 0)
+        return -1;
+    roa_union->damp_started = 1;
+    return 0;
+}
+
+void roa_union_stop_damping(struct roa_union *roa_union)
+{
+    if (!roa_union->damp_started)
+        return;
+    pthread_mutex_lock(&roa_union->mutex);
+    roa_union->damp_stop = 1;
+    pthread_cond_signal(&roa_union->damp_cond);
+    pthread_mutex_unlock(&roa_union->mutex);
+    pthread_join(roa_union->damp_thread, NULL);
+    roa_union->damp_started = 0;
+}
@@ -0,0 +1,146 @@
+/*
+ * This file is part of BIRD-RTRlib-CLI.
+ *
+ * BIRD-RTRlib-CLI is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * BIRD-RTRlib-CLI is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with BIRD-RTRlib-CLI; see the file COPYING.
+ *
+ * written by smlng and Mehmet Ceyran, in cooperation with:
+ * CST group, Freie Universitaet Berlin
+ * Website: https://github.com/rtrlib/bird-rtrlib-cli
+ */
+
+#ifndef BIRD_RTRLIB_CLI__UNION_H
+#define	BIRD_RTRLIB_CLI__UNION_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "damp.h"
+#include "update.h"
+#include "vrp.h"
+#include "writer.h"
+
+struct pfx_record;
+
+/**
+ * Union of the ROAs of all RTR caches, the value of every ROA counts the
+ * caches asserting it. Changes of the union go to all BIRD writers. Only
+ * the address families in `ip_version` ("4", "6" or both, NULL for all) are
+ * sent to BIRD.
+ */
+struct roa_union {
+    struct vrp_store store;
+    pthread_mutex_t mutex;
+    struct bird_writer *writers;
+    size_t writers_len;
+    const char *ip_version;
+    // Flap dampening of the changes and the thread releasing held back ROAs.
+    struct damp damp;
+    pthread_t damp_thread;
+    pthread_cond_t damp_cond;
+    int damp_started;
+    int damp_stop;
+};
+
+/**
+ * Initializes an empty union feeding the specified writers, which are
+ * counted in `writers_len` once they are set up, with the specified
+ * dampening half-life in seconds, 0 disables the dampening.
+ * @param roa_union
+ * @param writers
+ * @param ip_version
+ * @param half_life
+ */
+void roa_union_init(struct roa_union *roa_union, struct bird_writer *writers,
+                    const char *ip_version, unsigned int half_life);
+
+/**
+ * Releases the memory of the union, the dampening must be stopped.
+ * @param roa_union
+ */
+void roa_union_free(struct roa_union *roa_union);
+
+/**
+ * Returns nonzero if updates of the record's address family are sent to
+ * BIRD.
+ * @param roa_union
+ * @param record
+ * @return
+ */
+int roa_union_allowed(const struct roa_union *roa_union,
+                      const struct pfx_record *record);
+
+/**
+ * Queues an update for all BIRD writers, bypassing the union, e.g., when
+ * replaying.
+ * @param roa_union
+ * @param record
+ * @param added
+ */
+void roa_union_send(struct roa_union *roa_union,
+                    const struct pfx_record *record, int added);
+
+/**
+ * Applies an update of one cache to the ROA union and sends it to BIRD if
+ * it changes the union, i.e., the first cache announced or the last cache
+ * withdrew the ROA, unless the dampening holds back the announcement of a
+ * flapping ROA.
+ * @param roa_union
+ * @param record
+ * @param added
+ */
+void roa_union_update(struct roa_union *roa_union,
+                      const struct pfx_record *record, int added);
+
+/**
+ * Load function of the BIRD writers, fills the batch with the full ROA
+ * union after a writer (re)connected.
+ * @param writer
+ * @param batch
+ * @param data
+ */
+void roa_union_load(struct bird_writer *writer, struct update_batch *batch,
+                    void *data);
+
+/**
+ * Expect function of the BIRD writers, fills the batch with the ROAs of the
+ * union within the audited prefix and the shorter ones at its address.
+ * Returns -1 to skip address families not sent to BIRD.
+ * @param writer
+ * @param prefix
+ * @param prefix_len
+ * @param batch
+ * @param data
+ * @return
+ */
+int roa_union_expect(struct bird_writer *writer,
+                     const struct lrtr_ip_addr *prefix, uint8_t prefix_len,
+                     struct update_batch *batch, void *data);
+
+/**
+ * Starts releasing the ROAs held back by the dampening if it is enabled.
+ * Returns 0 on success or -1 on failure.
+ * @param roa_union
+ * @return
+ */
+int roa_union_start_damping(struct roa_union *roa_union);
+
+/**
+ * Stops releasing held back ROAs. Must be called before the BIRD writers
+ * are freed.
+ * @param roa_union
+ */
+void roa_union_stop_damping(struct roa_union *roa_union);
+
+#endif // BIRD_RTRLIB_CLI__UNION_H
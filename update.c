@@ -0,0 +1,176 @@
+/*
+ * This file is part of BIRD-RTRlib-CLI.
+ *
+ * BIRD-RTRlib-CLI is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * BIRD-RTRlib-CLI is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with BIRD-RTRlib-CLI; see the file COPYING.
+ *
+ * written by smlng and Mehmet Ceyran, in cooperation with:
+ * CST group, Freie Universitaet Berlin
+ * Website: https://github.com/rtrlib/bird-rtrlib-cli
+ */
+
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "update.h"
+
+// Initial capacity of a batch.
+#define UPDATE_BATCH_MIN_SIZE (1024)
+
+// Size of the binary sort key: family, address, min and max length, ASN.
+#define UPDATE_KEY_SIZE (23)
+
+// Sort key of an update and its position in the batch.
+struct update_key {
+    uint8_t key[UPDATE_KEY_SIZE];
+    uint32_t index;
+};
+
+// Builds the big-endian sort key of a record, IPv4 sorts before IPv6.
+static void update_key_set(struct update_key *key,
+                           const struct pfx_record *record, uint32_t index)
+{
+    memset(key->key, 0, UPDATE_KEY_SIZE);
+    if (record->prefix.ver == LRTR_IPV6) {
+        key->key[0] = 1;
+        for (int i = 0; i < 16; i++)
+            key->key[1 + i] = record->prefix.u.addr6.addr[i / 4] >>
+                              (24 - 8 * (i % 4));
+    } else {
+        for (int i = 0; i < 4; i++)
+            key->key[1 + i] = record->prefix.u.addr4.addr >> (24 - 8 * i);
+    }
+    key->key[17] = record->min_len;
+    key->key[18] = record->max_len;
+    for (int i = 0; i < 4; i++)
+        key->key[19 + i] = record->asn >> (24 - 8 * i);
+    key->index = index;
+}
+
+void update_batch_init(struct update_batch *batch)
+{
+    memset(batch, 0, sizeof (struct update_batch));
+}
+
+void update_batch_free(struct update_batch *batch)
+{
+    free(batch->updates);
+    update_batch_init(batch);
+}
+
+int update_batch_add(struct update_batch *batch,
+                     const struct pfx_record *record, int added)
+{
+    if (batch->len == batch->size) {
+        const size_t size = batch->size ?
+            batch->size * 2 : UPDATE_BATCH_MIN_SIZE;
+        struct update *updates = realloc(batch->updates,
+                                         size * sizeof (struct update));
+        if (!updates)
+            return -1;
+        batch->updates = updates;
+        batch->size = size;
+    }
+    batch->updates[batch->len].record = *record;
+    batch->updates[batch->len].added = added;
+    batch->len++;
+    return 0;
+}
+
+void update_batch_drop(struct update_batch *batch, size_t count)
+{
+    if (count >= batch->len) {
+        batch->len = 0;
+        return;
+    }
+    memmove(batch->updates, batch->updates + count,
+            (batch->len - count) * sizeof (struct update));
+    batch->len -= count;
+}
+
+int update_compare(const struct pfx_record *a, const struct pfx_record *b)
+{
+    struct update_key key_a, key_b;
+    update_key_set(&key_a, a, 0);
+    update_key_set(&key_b, b, 0);
+    return memcmp(key_a.key, key_b.key, UPDATE_KEY_SIZE);
+}
+
+int update_batch_sort(struct update_batch *batch)
+{
+    const size_t len = batch->len;
+    if (len < 2)
+        return 0;
+    if (len > UINT32_MAX)
+        return -1;
+    struct update_key *keys = malloc(len * sizeof (struct update_key));
+    struct update_key *buffer = malloc(len * sizeof (struct update_key));
+    size_t (*counts)[256] = calloc(UPDATE_KEY_SIZE, sizeof (*counts));
+    struct update *updates = malloc(batch->size * sizeof (struct update));
+    if (!keys || !buffer || !counts || !updates) {
+        free(keys);
+        free(buffer);
+        free(counts);
+        free(updates);
+        return -1;
+    }
+    // Build the keys and the histograms of all key bytes in one pass.
+    for (size_t i = 0; i < len; i++) {
+        update_key_set(&keys[i], &batch->updates[i].record, i);
+        for (int b = 0; b < UPDATE_KEY_SIZE; b++)
+            counts[b][keys[i].key[b]]++;
+    }
+    // LSD radix sort, one stable counting pass per key byte. Bytes that are
+    // equal in all keys, like the unused address bytes of IPv4 prefixes in
+    // an IPv4-only batch, need no pass.
+    for (int b = UPDATE_KEY_SIZE - 1; b >= 0; b--) {
+        if (counts[b][keys[0].key[b]] == len)
+            continue;
+        size_t offset = 0;
+        for (int v = 0; v < 256; v++) {
+            const size_t count = counts[b][v];
+            counts[b][v] = offset;
+            offset += count;
+        }
+        for (size_t i = 0; i < len; i++)
+            buffer[counts[b][keys[i].key[b]]++] = keys[i];
+        struct update_key *sorted = buffer;
+        buffer = keys;
+        keys = sorted;
+    }
+    // Gather the updates in key order. The sort is stable, so of a run of
+    // equal keys the first one is the oldest and the last one the most
+    // recent update of that ROA. A ROA added and deleted again within the
+    // run was not in BIRD before, so the run cancels out.
+    size_t out = 0;
+    size_t first = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (i + 1 < len &&
+            memcmp(keys[i].key, keys[i + 1].key, UPDATE_KEY_SIZE) == 0)
+            continue;
+        const struct update *last = &batch->updates[keys[i].index];
+        if (i == first || !batch->updates[keys[first].index].added ||
+            last->added)
+            updates[out++] = *last;
+        first = i + 1;
+    }
+    free(batch->updates);
+    batch->updates = updates;
+    batch->len = out;
+    free(keys);
+    free(buffer);
+    free(counts);
+    return 0;
+}
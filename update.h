@@ -0,0 +1,98 @@
+/*
+ * This file is part of BIRD-RTRlib-CLI.
+ *
+ * BIRD-RTRlib-CLI is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * BIRD-RTRlib-CLI is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with BIRD-RTRlib-CLI; see the file COPYING.
+ *
+ * written by smlng and Mehmet Ceyran, in cooperation with:
+ * CST group, Freie Universitaet Berlin
+ * Website: https://github.com/rtrlib/bird-rtrlib-cli
+ */
+
+
+#ifndef BIRD_RTRLIB_CLI__UPDATE_H
+#define	BIRD_RTRLIB_CLI__UPDATE_H
+
+#include <stddef.h>
+
+#include <rtrlib/rtrlib.h>
+
+/**
+ * A ROA to be added to or deleted from BIRD.
+ */
+struct update {
+    struct pfx_record record;
+    int added;
+};
+
+/**
+ * Growing array of updates.
+ */
+struct update_batch {
+    struct update *updates;
+    size_t len;
+    size_t size;
+};
+
+/**
+ * Initializes an empty batch.
+ * @param batch
+ */
+void update_batch_init(struct update_batch *batch);
+
+/**
+ * Releases the memory of a batch.
+ * @param batch
+ */
+void update_batch_free(struct update_batch *batch);
+
+/**
+ * Appends an update to the batch. Returns 0 on success or -1 on failure.
+ * @param batch
+ * @param record
+ * @param added
+ * @return
+ */
+int update_batch_add(struct update_batch *batch,
+                     const struct pfx_record *record, int added);
+
+/**
+ * Removes the first `count` updates from the batch.
+ * @param batch
+ * @param count
+ */
+void update_batch_drop(struct update_batch *batch, size_t count);
+
+/**
+ * Sorts the batch by address family, prefix, prefix lengths and origin AS
+ * with a stable radix sort and coalesces updates of the same ROA into the
+ * last one, i.e., the one that reflects its final state. Updates of a ROA
+ * that is first added and finally deleted are dropped altogether, as BIRD
+ * did not have it before. Returns 0 on success or -1 on failure, in which
+ * case the batch is left unchanged.
+ * @param batch
+ * @return
+ */
+int update_batch_sort(struct update_batch *batch);
+
+/**
+ * Compares two records in the order of `update_batch_sort()`. Returns a
+ * negative value, 0 or a positive value if `a` sorts before, equal to or
+ * after `b`.
+ * @param a
+ * @param b
+ * @return
+ */
+int update_compare(const struct pfx_record *a, const struct pfx_record *b);
+
+#endif // BIRD_RTRLIB_CLI__UPDATE_H
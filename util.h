@@ -0,0 +1,44 @@
+/*
+ * This file is part of BIRD-RTRlib-CLI.
+ *
+ * BIRD-RTRlib-CLI is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * BIRD-RTRlib-CLI is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with BIRD-RTRlib-CLI; see the file COPYING.
+ *
+ * written by smlng and Mehmet Ceyran, in cooperation with:
+ * CST group, Freie Universitaet Berlin
+ * Website: https://github.com/rtrlib/bird-rtrlib-cli
+ */
+
+#ifndef BIRD_RTRLIB_CLI__UTIL_H
+#define	BIRD_RTRLIB_CLI__UTIL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Returns a monotonic timestamp in microseconds.
+ * @return
+ */
+uint64_t util_clock(void);
+
+/**
+ * Writes the whole buffer to the file descriptor, retrying interrupted and
+ * partial writes. Returns 0 on success or -1 on failure.
+ * @param fd
+ * @param buffer
+ * @param length
+ * @return
+ */
+int util_write_all(int fd, const char *buffer, size_t length);
+
+#endif
@@ -0,0 +1,530 @@
+/*
+ * This file is part of BIRD-RTRlib-CLI.
+ *
+ * BIRD-RTRlib-CLI is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * BIRD-RTRlib-CLI is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with BIRD-RTRlib-CLI; see the file COPYING.
+ *
+ * written by smlng and Mehmet Ceyran, in cooperation with:
+ * CST group, Freie Universitaet Berlin
+ * Website: https://github.com/rtrlib/bird-rtrlib-cli
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "vrp.h"
+#include <rtrlib/rtrlib.h>
+
+// Entries per chunk.
+#define VRP_CHUNK_SIZE (1u << VRP_CHUNK_BITS)
+// Mask of the index within a chunk.
+#define VRP_CHUNK_MASK (VRP_CHUNK_SIZE - 1)
+// Mask of the entry index + 1 in a hash slot.
+#define VRP_SLOT_INDEX_MASK (0xffffff)
+// Maximum number of entries per pool, limited by the hash slot layout.
+#define VRP_POOL_MAX (VRP_SLOT_INDEX_MASK - 1)
+// Maximum load of the hash slots in percent.
+#define VRP_MAX_LOAD (85)
+// Minimum number of hash slots.
+#define VRP_MIN_SLOTS (64)
+
+// A VRP in the representation of the pools.
+struct vrp_key {
+    unsigned int pool;
+    unsigned char addr[16];
+    uint8_t min_len;
+    uint8_t max_len;
+    uint32_t asn;
+    uint64_t hash;
+};
+
+// Column accessors. A chunk holds the columns ASN (4 bytes), prefix (width
+// bytes), min_len, max_len (1 byte) and value, each VRP_CHUNK_SIZE entries.
+static inline uint32_t *vrp_asn(const struct vrp_pool *pool, uint32_t i)
+{
+    return (uint32_t *) pool->chunks[i >> VRP_CHUNK_BITS] +
+        (i & VRP_CHUNK_MASK);
+}
+
+static inline unsigned char *vrp_addr(const struct vrp_pool *pool, uint32_t i)
+{
+    return pool->chunks[i >> VRP_CHUNK_BITS] + 4 * VRP_CHUNK_SIZE +
+        (i & VRP_CHUNK_MASK) * pool->width;
+}
+
+static inline unsigned char *vrp_min_len(const struct vrp_pool *pool,
+                                         uint32_t i)
+{
+    return pool->chunks[i >> VRP_CHUNK_BITS] +
+        (4 + pool->width) * VRP_CHUNK_SIZE + (i & VRP_CHUNK_MASK);
+}
+
+static inline unsigned char *vrp_max_len(const struct vrp_pool *pool,
+                                         uint32_t i)
+{
+    return vrp_min_len(pool, i) + VRP_CHUNK_SIZE;
+}
+
+static inline unsigned char *vrp_value(const struct vrp_store *store,
+                                       const struct vrp_pool *pool, uint32_t i)
+{
+    return pool->chunks[i >> VRP_CHUNK_BITS] +
+        (6 + pool->width) * VRP_CHUNK_SIZE +
+        (i & VRP_CHUNK_MASK) * store->value_size;
+}
+
+static inline size_t vrp_chunk_bytes(const struct vrp_store *store,
+                                     const struct vrp_pool *pool)
+{
+    return (6 + pool->width + store->value_size) * VRP_CHUNK_SIZE;
+}
+
+static uint64_t vrp_hash(const unsigned char *addr, unsigned int width,
+                         uint8_t min_len, uint8_t max_len, uint32_t asn)
+{
+    uint64_t hash = ((uint64_t) asn << 16 | min_len << 8 | max_len) ^
+        (0x9e3779b97f4a7c15ULL * width);
+    for (unsigned int i = 0; i < width; i++)
+        hash = (hash ^ addr[i]) * 0x100000001b3ULL;
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+// Maps a hash to the home slot of a pool.
+static inline uint32_t vrp_home(const struct vrp_pool *pool, uint64_t hash)
+{
+    return ((hash & 0xffffffff) * pool->slots_len) >> 32;
+}
+
+static inline uint32_t vrp_tag(uint64_t hash)
+{
+    return (hash >> 56) << 24;
+}
+
+// Converts a record into its pool representation.
+static void vrp_make_key(const struct pfx_record *record, struct vrp_key *key)
+{
+    const int ipv6 = record->prefix.ver == LRTR_IPV6;
+    unsigned int width = (record->min_len + 7) / 8;
+    if (width == 0)
+        width = 1;
+    if (width > (ipv6 ? 16u : 4u))
+        width = ipv6 ? 16 : 4;
+    memset(key, 0, sizeof (struct vrp_key));
+    if (ipv6) {
+        for (int i = 0; i < 16; i++)
+            key->addr[i] = record->prefix.u.addr6.addr[i / 4] >>
+                (24 - 8 * (i % 4));
+    } else {
+        for (int i = 0; i < 4; i++)
+            key->addr[i] = record->prefix.u.addr4.addr >> (24 - 8 * i);
+    }
+    // Only the significant bytes are stored.
+    memset(key->addr + width, 0, 16 - width);
+    key->pool = (ipv6 ? 4 : 0) + width - 1;
+    key->min_len = record->min_len;
+    key->max_len = record->max_len;
+    key->asn = record->asn;
+    key->hash = vrp_hash(key->addr, width, key->min_len, key->max_len,
+                         key->asn);
+}
+
+// Converts an entry back into a record.
+static void vrp_make_record(const struct vrp_pool *pool, unsigned int pool_id,
+                            uint32_t i, struct pfx_record *record)
+{
+    const unsigned char *addr = vrp_addr(pool, i);
+    memset(record, 0, sizeof (struct pfx_record));
+    if (pool_id >= 4) {
+        record->prefix.ver = LRTR_IPV6;
+        for (unsigned int b = 0; b < pool->width; b++)
+            record->prefix.u.addr6.addr[b / 4] |=
+                (uint32_t) addr[b] << (24 - 8 * (b % 4));
+    } else {
+        record->prefix.ver = LRTR_IPV4;
+        for (unsigned int b = 0; b < pool->width; b++)
+            record->prefix.u.addr4.addr |= (uint32_t) addr[b] << (24 - 8 * b);
+    }
+    record->min_len = *vrp_min_len(pool, i);
+    record->max_len = *vrp_max_len(pool, i);
+    record->asn = *vrp_asn(pool, i);
+}
+
+static inline int vrp_equal(const struct vrp_pool *pool, uint32_t i,
+                            const struct vrp_key *key)
+{
+    return *vrp_asn(pool, i) == key->asn &&
+        *vrp_min_len(pool, i) == key->min_len &&
+        *vrp_max_len(pool, i) == key->max_len &&
+        memcmp(vrp_addr(pool, i), key->addr, pool->width) == 0;
+}
+
+// Returns the slot of the key or of the empty slot ending its probe sequence.
+static uint32_t vrp_probe(const struct vrp_pool *pool,
+                          const struct vrp_key *key)
+{
+    const uint32_t tag = vrp_tag(key->hash);
+    uint32_t s = vrp_home(pool, key->hash);
+    while (pool->slots[s]) {
+        const uint32_t slot = pool->slots[s];
+        if ((slot & ~VRP_SLOT_INDEX_MASK) == tag &&
+            vrp_equal(pool, (slot & VRP_SLOT_INDEX_MASK) - 1, key))
+            return s;
+        if (++s == pool->slots_len)
+            s = 0;
+    }
+    return s;
+}
+
+// Recomputes the hash of an entry.
+static uint64_t vrp_entry_hash(const struct vrp_pool *pool, uint32_t i)
+{
+    return vrp_hash(vrp_addr(pool, i), pool->width, *vrp_min_len(pool, i),
+                    *vrp_max_len(pool, i), *vrp_asn(pool, i));
+}
+
+// Grows the hash slots by a quarter and reinserts all entries.
+static int vrp_grow_slots(struct vrp_pool *pool)
+{
+    uint32_t len = pool->slots_len + pool->slots_len / 4;
+    if (len < VRP_MIN_SLOTS)
+        len = VRP_MIN_SLOTS;
+    uint32_t *slots = calloc(len, sizeof (uint32_t));
+    if (!slots)
+        return -1;
+    free(pool->slots);
+    pool->slots = slots;
+    pool->slots_len = len;
+    for (uint32_t i = 0; i < pool->count; i++) {
+        const uint64_t hash = vrp_entry_hash(pool, i);
+        uint32_t s = vrp_home(pool, hash);
+        while (pool->slots[s])
+            if (++s == pool->slots_len)
+                s = 0;
+        pool->slots[s] = vrp_tag(hash) | (i + 1);
+    }
+    return 0;
+}
+
+void vrp_store_init(struct vrp_store *store, size_t value_size)
+{
+    memset(store, 0, sizeof (struct vrp_store));
+    store->value_size = value_size;
+    for (unsigned int p = 0; p < VRP_POOLS; p++)
+        store->pools[p].width = p < 4 ? p + 1 : p - 3;
+}
+
+void vrp_store_free(struct vrp_store *store)
+{
+    for (unsigned int p = 0; p < VRP_POOLS; p++) {
+        struct vrp_pool *pool = &store->pools[p];
+        for (uint32_t c = 0; c < pool->chunks_len; c++)
+            free(pool->chunks[c]);
+        free(pool->chunks);
+        free(pool->slots);
+    }
+    vrp_store_init(store, store->value_size);
+}
+
+int vrp_store_add(struct vrp_store *store, const struct pfx_record *record,
+                  void **value)
+{
+    struct vrp_key key;
+    vrp_make_key(record, &key);
+    struct vrp_pool *pool = &store->pools[key.pool];
+    // Keep the load of the hash slots bounded.
+    if ((uint64_t) (pool->count + 1) * 100 >
+        (uint64_t) pool->slots_len * VRP_MAX_LOAD &&
+        vrp_grow_slots(pool) != 0)
+        return -1;
+    const uint32_t s = vrp_probe(pool, &key);
+    if (pool->slots[s]) {
+        if (value)
+            *value = vrp_value(store, pool, (pool->slots[s] &
+                                             VRP_SLOT_INDEX_MASK) - 1);
+        return 0;
+    }
+    if (pool->count >= VRP_POOL_MAX)
+        return -1;
+    // Allocate a new chunk if the last one is full.
+    const uint32_t i = pool->count;
+    if ((i >> VRP_CHUNK_BITS) >= pool->chunks_len) {
+        unsigned char **chunks = realloc(pool->chunks,
+            (pool->chunks_len + 1) * sizeof (unsigned char *));
+        if (!chunks)
+            return -1;
+        pool->chunks = chunks;
+        pool->chunks[pool->chunks_len] =
+            malloc(vrp_chunk_bytes(store, pool));
+        if (!pool->chunks[pool->chunks_len])
+            return -1;
+        pool->chunks_len++;
+    }
+    *vrp_asn(pool, i) = key.asn;
+    memcpy(vrp_addr(pool, i), key.addr, pool->width);
+    *vrp_min_len(pool, i) = key.min_len;
+    *vrp_max_len(pool, i) = key.max_len;
+    memset(vrp_value(store, pool, i), 0, store->value_size);
+    pool->slots[s] = vrp_tag(key.hash) | (i + 1);
+    pool->count++;
+    if (value)
+        *value = vrp_value(store, pool, i);
+    return 1;
+}
+
+int vrp_store_find(const struct vrp_store *store,
+                   const struct pfx_record *record, void **value)
+{
+    struct vrp_key key;
+    vrp_make_key(record, &key);
+    const struct vrp_pool *pool = &store->pools[key.pool];
+    if (pool->count == 0)
+        return 0;
+    const uint32_t s = vrp_probe(pool, &key);
+    if (!pool->slots[s])
+        return 0;
+    if (value)
+        *value = vrp_value(store, pool,
+                           (pool->slots[s] & VRP_SLOT_INDEX_MASK) - 1);
+    return 1;
+}
+
+int vrp_store_remove(struct vrp_store *store, const struct pfx_record *record)
+{
+    struct vrp_key key;
+    vrp_make_key(record, &key);
+    struct vrp_pool *pool = &store->pools[key.pool];
+    if (pool->count == 0)
+        return 0;
+    uint32_t hole = vrp_probe(pool, &key);
+    if (!pool->slots[hole])
+        return 0;
+    const uint32_t i = (pool->slots[hole] & VRP_SLOT_INDEX_MASK) - 1;
+    // Backward shift deletion keeps probe sequences without tombstones.
+    pool->slots[hole] = 0;
+    uint32_t s = hole;
+    for (;;) {
+        if (++s == pool->slots_len)
+            s = 0;
+        if (!pool->slots[s])
+            break;
+        const uint32_t home = vrp_home(pool, vrp_entry_hash(pool,
+            (pool->slots[s] & VRP_SLOT_INDEX_MASK) - 1));
+        // Move the entry unless its home lies cyclically in (hole, s].
+        const int stays = hole <= s ? (home > hole && home <= s) :
+                                      (home > hole || home <= s);
+        if (!stays) {
+            pool->slots[hole] = pool->slots[s];
+            pool->slots[s] = 0;
+            hole = s;
+        }
+    }
+    // Fill the gap in the columns with the last entry.
+    const uint32_t last = pool->count - 1;
+    if (i != last) {
+        const uint64_t hash = vrp_entry_hash(pool, last);
+        s = vrp_home(pool, hash);
+        while ((pool->slots[s] & VRP_SLOT_INDEX_MASK) != last + 1)
+            if (++s == pool->slots_len)
+                s = 0;
+        pool->slots[s] = vrp_tag(hash) | (i + 1);
+        *vrp_asn(pool, i) = *vrp_asn(pool, last);
+        memcpy(vrp_addr(pool, i), vrp_addr(pool, last), pool->width);
+        *vrp_min_len(pool, i) = *vrp_min_len(pool, last);
+        *vrp_max_len(pool, i) = *vrp_max_len(pool, last);
+        memcpy(vrp_value(store, pool, i), vrp_value(store, pool, last),
+               store->value_size);
+    }
+    pool->count--;
+    return 1;
+}
+
+void vrp_store_clear(struct vrp_store *store)
+{
+    for (unsigned int p = 0; p < VRP_POOLS; p++) {
+        struct vrp_pool *pool = &store->pools[p];
+        pool->count = 0;
+        if (pool->slots)
+            memset(pool->slots, 0, pool->slots_len * sizeof (uint32_t));
+    }
+}
+
+size_t vrp_store_count(const struct vrp_store *store)
+{
+    size_t count = 0;
+    for (unsigned int p = 0; p < VRP_POOLS; p++)
+        count += store->pools[p].count;
+    return count;
+}
+
+size_t vrp_store_memory(const struct vrp_store *store)
+{
+    size_t bytes = sizeof (struct vrp_store);
+    for (unsigned int p = 0; p < VRP_POOLS; p++) {
+        const struct vrp_pool *pool = &store->pools[p];
+        bytes += pool->chunks_len *
+            (vrp_chunk_bytes(store, pool) + sizeof (unsigned char *));
+        bytes += pool->slots_len * sizeof (uint32_t);
+    }
+    return bytes;
+}
+
+void vrp_store_for_each(const struct vrp_store *store, vrp_store_fp fp,
+                        void *data)
+{
+    struct pfx_record record;
+    for (unsigned int p = 0; p < VRP_POOLS; p++) {
+        const struct vrp_pool *pool = &store->pools[p];
+        for (uint32_t i = 0; i < pool->count; i++) {
+            vrp_make_record(pool, p, i, &record);
+            fp(&record, vrp_value(store, pool, i), data);
+        }
+    }
+}
+
+void vrp_store_for_each_in(const struct vrp_store *store,
+                           const struct lrtr_ip_addr *prefix,
+                           uint8_t prefix_len, vrp_store_fp fp, void *data)
+{
+    struct pfx_record record;
+    struct vrp_key key;
+    memset(&record, 0, sizeof (struct pfx_record));
+    record.prefix = *prefix;
+    record.min_len = prefix_len;
+    vrp_make_key(&record, &key);
+    // Prefixes within have at least as many significant bytes.
+    const unsigned int last = prefix->ver == LRTR_IPV6 ? VRP_POOLS : 4;
+    const unsigned int bytes = prefix_len / 8;
+    const unsigned char mask = 0xff00 >> (prefix_len % 8);
+    for (unsigned int p = key.pool; p < last; p++) {
+        const struct vrp_pool *pool = &store->pools[p];
+        for (uint32_t i = 0; i < pool->count; i++) {
+            const unsigned char *addr = vrp_addr(pool, i);
+            if (*vrp_min_len(pool, i) < prefix_len ||
+                memcmp(addr, key.addr, bytes) != 0 ||
+                (mask && ((addr[bytes] ^ key.addr[bytes]) & mask) != 0))
+                continue;
+            vrp_make_record(pool, p, i, &record);
+            fp(&record, vrp_value(store, pool, i), data);
+        }
+    }
+}
+
+void vrp_store_for_each_at(const struct vrp_store *store,
+                           const struct lrtr_ip_addr *prefix,
+                           uint8_t prefix_len, vrp_store_fp fp, void *data)
+{
+    struct pfx_record record;
+    struct vrp_key key;
+    memset(&record, 0, sizeof (struct pfx_record));
+    record.prefix = *prefix;
+    record.min_len = prefix_len;
+    vrp_make_key(&record, &key);
+    // Shorter prefixes have at most as many significant bytes, but enough
+    // for the nonzero bytes of the address.
+    const unsigned int first = prefix->ver == LRTR_IPV6 ? 4 : 0;
+    unsigned int used = key.pool - first + 1;
+    while (used > 0 && key.addr[used - 1] == 0)
+        used--;
+    for (unsigned int p = first; p <= key.pool; p++) {
+        const struct vrp_pool *pool = &store->pools[p];
+        if (pool->width < used)
+            continue;
+        for (uint32_t i = 0; i < pool->count; i++) {
+            if (*vrp_min_len(pool, i) >= prefix_len ||
+                memcmp(vrp_addr(pool, i), key.addr, pool->width) != 0)
+                continue;
+            vrp_make_record(pool, p, i, &record);
+            fp(&record, vrp_value(store, pool, i), data);
+        }
+    }
+}
+
+// Compares two entries referenced as pool << 24 | index.
+static int vrp_compare(const struct vrp_store *store, uint32_t a, uint32_t b)
+{
+    const unsigned int pa = a >> 24, pb = b >> 24;
+    const struct vrp_pool *pool_a = &store->pools[pa];
+    const struct vrp_pool *pool_b = &store->pools[pb];
+    a &= VRP_SLOT_INDEX_MASK;
+    b &= VRP_SLOT_INDEX_MASK;
+    // IPv4 before IPv6.
+    if ((pa >= 4) != (pb >= 4))
+        return pa >= 4 ? 1 : -1;
+    // Prefix bytes, missing bytes are zero.
+    const unsigned char *addr_a = vrp_addr(pool_a, a);
+    const unsigned char *addr_b = vrp_addr(pool_b, b);
+    const unsigned int width = pool_a->width > pool_b->width ?
+        pool_a->width : pool_b->width;
+    for (unsigned int i = 0; i < width; i++) {
+        const unsigned char x = i < pool_a->width ? addr_a[i] : 0;
+        const unsigned char y = i < pool_b->width ? addr_b[i] : 0;
+        if (x != y)
+            return x < y ? -1 : 1;
+    }
+    if (*vrp_min_len(pool_a, a) != *vrp_min_len(pool_b, b))
+        return *vrp_min_len(pool_a, a) < *vrp_min_len(pool_b, b) ? -1 : 1;
+    if (*vrp_max_len(pool_a, a) != *vrp_max_len(pool_b, b))
+        return *vrp_max_len(pool_a, a) < *vrp_max_len(pool_b, b) ? -1 : 1;
+    if (*vrp_asn(pool_a, a) != *vrp_asn(pool_b, b))
+        return *vrp_asn(pool_a, a) < *vrp_asn(pool_b, b) ? -1 : 1;
+    return 0;
+}
+
+int vrp_store_for_each_sorted(const struct vrp_store *store, vrp_store_fp fp,
+                              void *data)
+{
+    struct pfx_record record;
+    const size_t count = vrp_store_count(store);
+    uint32_t *refs = malloc(count * sizeof (uint32_t) + 1);
+    uint32_t *tmp = malloc(count * sizeof (uint32_t) + 1);
+    if (!refs || !tmp) {
+        free(refs);
+        free(tmp);
+        return -1;
+    }
+    size_t n = 0;
+    for (unsigned int p = 0; p < VRP_POOLS; p++)
+        for (uint32_t i = 0; i < store->pools[p].count; i++)
+            refs[n++] = p << 24 | i;
+    // Bottom-up merge sort of the references.
+    for (size_t width = 1; width < count; width *= 2) {
+        for (size_t lo = 0; lo < count; lo += 2 * width) {
+            size_t mid = lo + width < count ? lo + width : count;
+            size_t hi = lo + 2 * width < count ? lo + 2 * width : count;
+            size_t i = lo, j = mid, k = lo;
+            while (i < mid && j < hi)
+                tmp[k++] = vrp_compare(store, refs[j], refs[i]) < 0 ?
+                    refs[j++] : refs[i++];
+            while (i < mid)
+                tmp[k++] = refs[i++];
+            while (j < hi)
+                tmp[k++] = refs[j++];
+        }
+        uint32_t *swap = refs;
+        refs = tmp;
+        tmp = swap;
+    }
+    for (size_t r = 0; r < count; r++) {
+        const unsigned int p = refs[r] >> 24;
+        const uint32_t i = refs[r] & VRP_SLOT_INDEX_MASK;
+        vrp_make_record(&store->pools[p], p, i, &record);
+        fp(&record, vrp_value(store, &store->pools[p], i), data);
+    }
+    free(refs);
+    free(tmp);
+    return 0;
+}
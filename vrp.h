@@ -0,0 +1,186 @@
+/*
+ * This file is part of BIRD-RTRlib-CLI.
+ *
+ * BIRD-RTRlib-CLI is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * BIRD-RTRlib-CLI is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with BIRD-RTRlib-CLI; see the file COPYING.
+ *
+ * written by smlng and Mehmet Ceyran, in cooperation with:
+ * CST group, Freie Universitaet Berlin
+ * Website: https://github.com/rtrlib/bird-rtrlib-cli
+ */
+
+
+#ifndef BIRD_RTRLIB_CLI__VRP_H
+#define	BIRD_RTRLIB_CLI__VRP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// Entries per arena chunk, as a power of two.
+#define VRP_CHUNK_BITS (12)
+/// Number of pools: IPv4 with 1..4, IPv6 with 1..16 significant bytes.
+#define VRP_POOLS (4 + 16)
+
+struct lrtr_ip_addr;
+struct pfx_record;
+
+/**
+ * VRPs of one address family with the same number of significant prefix
+ * bytes. Entries are stored as struct of arrays in chunks of
+ * 2^VRP_CHUNK_BITS entries: ASN, prefix bytes, minimum and maximum length
+ * and an optional value. The hash slots hold an 8 bit tag and the entry
+ * index + 1 in the lower 24 bits, 0 marks an empty slot.
+ */
+struct vrp_pool {
+    unsigned int width;
+    uint32_t count;
+    uint32_t chunks_len;
+    unsigned char **chunks;
+    uint32_t *slots;
+    uint32_t slots_len;
+};
+
+/**
+ * Compact set of VRPs with an optional fixed size value per VRP, e.g., a
+ * reference count. Not thread safe.
+ */
+struct vrp_store {
+    struct vrp_pool pools[VRP_POOLS];
+    size_t value_size;
+};
+
+/**
+ * Function called for every VRP when iterating a store.
+ */
+typedef void (*vrp_store_fp)(const struct pfx_record *record, void *value,
+                             void *data);
+
+/**
+ * Initializes an empty store keeping `value_size` bytes per VRP.
+ * @param store
+ * @param value_size
+ */
+void vrp_store_init(struct vrp_store *store, size_t value_size);
+
+/**
+ * Releases all memory of the store.
+ * @param store
+ */
+void vrp_store_free(struct vrp_store *store);
+
+/**
+ * Adds a VRP to the store. Points `*value`, if not NULL, to the value of the
+ * VRP, which is zeroed for new VRPs. Value pointers stay valid until the
+ * next removal. Returns 1 if the VRP was added, 0 if it already existed or
+ * -1 on failure.
+ * @param store
+ * @param record
+ * @param value
+ * @return
+ */
+int vrp_store_add(struct vrp_store *store, const struct pfx_record *record,
+                  void **value);
+
+/**
+ * Looks up a VRP and points `*value`, if not NULL, to its value. Returns 1
+ * if the VRP was found or 0 otherwise.
+ * @param store
+ * @param record
+ * @param value
+ * @return
+ */
+int vrp_store_find(const struct vrp_store *store,
+                   const struct pfx_record *record, void **value);
+
+/**
+ * Removes a VRP. Returns 1 if it was removed or 0 if it was not found.
+ * @param store
+ * @param record
+ * @return
+ */
+int vrp_store_remove(struct vrp_store *store, const struct pfx_record *record);
+
+/**
+ * Removes all VRPs, keeping the allocated memory.
+ * @param store
+ */
+void vrp_store_clear(struct vrp_store *store);
+
+/**
+ * Returns the number of VRPs in the store.
+ * @param store
+ * @return
+ */
+size_t vrp_store_count(const struct vrp_store *store);
+
+/**
+ * Returns the number of bytes allocated by the store.
+ * @param store
+ * @return
+ */
+size_t vrp_store_memory(const struct vrp_store *store);
+
+/**
+ * Calls `fp` for every VRP in no particular order. The store must not be
+ * modified by `fp`.
+ * @param store
+ * @param fp
+ * @param data
+ */
+void vrp_store_for_each(const struct vrp_store *store, vrp_store_fp fp,
+                        void *data);
+
+/**
+ * Calls `fp` for every VRP within the specified prefix, i.e., of the same
+ * address family with a prefix length of at least `prefix_len` and the same
+ * first `prefix_len` bits, in no particular order. Only the pools that can
+ * hold such VRPs are scanned. The store must not be modified by `fp`.
+ * @param store
+ * @param prefix
+ * @param prefix_len
+ * @param fp
+ * @param data
+ */
+void vrp_store_for_each_in(const struct vrp_store *store,
+                           const struct lrtr_ip_addr *prefix,
+                           uint8_t prefix_len, vrp_store_fp fp, void *data);
+
+/**
+ * Calls `fp` for every VRP with a prefix length below `prefix_len` and the
+ * same address as the specified prefix, i.e., the shorter VRPs starting at
+ * it, in no particular order. Together with `vrp_store_for_each_in()` this
+ * covers every VRP exactly once for a partition of the address space into
+ * prefixes. The store must not be modified by `fp`.
+ * @param store
+ * @param prefix
+ * @param prefix_len
+ * @param fp
+ * @param data
+ */
+void vrp_store_for_each_at(const struct vrp_store *store,
+                           const struct lrtr_ip_addr *prefix,
+                           uint8_t prefix_len, vrp_store_fp fp, void *data);
+
+/**
+ * Calls `fp` for every VRP, IPv4 before IPv6, ordered by prefix, prefix
+ * length, maximum length and ASN. The store must not be modified by `fp`.
+ * Returns 0 on success or -1 on failure.
+ * @param store
+ * @param fp
+ * @param data
+ * @return
+ */
+int vrp_store_for_each_sorted(const struct vrp_store *store, vrp_store_fp fp,
+                              void *data);
+
+#endif // BIRD_RTRLIB_CLI__VRP_H
@@ -0,0 +1,831 @@
+/*
+ * This file is part of BIRD-RTRlib-CLI.
+ *
+ * BIRD-RTRlib-CLI is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * BIRD-RTRlib-CLI is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with BIRD-RTRlib-CLI; see the file COPYING.
+ *
+ * written by smlng and Mehmet Ceyran, in cooperation with:
+ * CST group, Freie Universitaet Berlin
+ * Website: https://github.com/rtrlib/bird-rtrlib-cli
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+
+#include "trace.h"
+#include "util.h"
+#include "writer.h"
+
+int bird_writer_init(struct bird_writer *writer, const char *socket_path,
+                     const char *roa_table, bird_writer_load_fp load,
+                     void *load_data)
+{
+    memset(writer, 0, sizeof (struct bird_writer));
+    writer->socket = -1;
+    writer->window_min = 1;
+    writer->window_max = BIRD_WRITER_WINDOW_MAX;
+    writer->load = load;
+    writer->load_data = load_data;
+    update_batch_init(&writer->pending);
+    vrp_store_init(&writer->audit_deleted, 0);
+    vrp_store_init(&writer->audit_refused, 0);
+    pthread_mutex_init(&writer->mutex, NULL);
+    pthread_cond_init(&writer->cond, NULL);
+    pthread_cond_init(&writer->idle_cond, NULL);
+    // " table " + <roa_table> + \0, or an empty string.
+    const size_t table_arg_size = roa_table ? 8 + strlen(roa_table) : 1;
+    writer->socket_path = strdup(socket_path);
+    writer->table_arg = malloc(table_arg_size);
+    if (writer->table_arg) {
+        if (roa_table)
+            snprintf(writer->table_arg, table_arg_size, " table %s",
+                     roa_table);
+        else
+            writer->table_arg[0] = 0;
+    }
+    // Size of the buffer ("delete roa " + <addr> + "/" + <minlen> + " max " +
+    // <maxlen> + " as " + <asnum> + <table_arg> + "\n" + \0)
+    writer->command_size = (
+        11 + // "delete roa "
+        INET6_ADDRSTRLEN + // maximum length of an IPv6 address
+        1 + // "/"
+        3 + // minimum length, "0" .. "128"
+        5 + // " max "
+        3 + // maximum length, "0" .. "128"
+        4 + // " as "
+        10 + // asnum, "0" .. "2^32 - 1" (max 10 chars)
+        table_arg_size + // " table " + <table> + \0
+        1 // "\n"
+    ) * sizeof (char);
+    writer->command = malloc(writer->command_size);
+    if (!writer->socket_path || !writer->table_arg || !writer->command) {
+        bird_writer_free(writer);
+        return -1;
+    }
+    return 0;
+}
+
+void bird_writer_free(struct bird_writer *writer)
+{
+    free(writer->socket_path);
+    free(writer->table_arg);
+    free(writer->command);
+    free(writer->window_buffer);
+    free(writer->window_lengths);
+    writer->socket_path = 0;
+    writer->table_arg = 0;
+    writer->command = 0;
+    writer->window_buffer = 0;
+    writer->window_lengths = 0;
+    update_batch_free(&writer->pending);
+    vrp_store_free(&writer->audit_deleted);
+    vrp_store_free(&writer->audit_refused);
+    pthread_mutex_destroy(&writer->mutex);
+    pthread_cond_destroy(&writer->cond);
+    pthread_cond_destroy(&writer->idle_cond);
+}
+
+/**
+ * Translates an update to a BIRD `add roa` or `delete roa` command in the
+ * specified buffer of `command_size` bytes. Returns the length of the
+ * command or -1 if it does not fit.
+ * @param writer
+ * @param update
+ * @param command
+ * @return
+ */
+static int bird_writer_format(struct bird_writer *writer,
+                              const struct update *update, char *command)
+{
+    char ip_addr_str[INET6_ADDRSTRLEN];
+    const struct pfx_record *record = &update->record;
+    // Fetch IP address as string.
+    lrtr_ip_addr_to_str(&(record->prefix), ip_addr_str, sizeof(ip_addr_str));
+    // Write BIRD command to buffer.
+    const int length = snprintf(
+        command,
+        writer->command_size,
+        "%s roa %s/%u max %u as %u%s\n",
+        update->added ? "add" : "delete",
+        ip_addr_str,
+        record->min_len,
+        record->max_len,
+        record->asn,
+        writer->table_arg
+    );
+    if (length < 0 || (size_t) length >= writer->command_size) {
+        syslog(LOG_ERR, "BIRD command too long.");
+        return -1;
+    }
+    return length;
+}
+
+/**
+ * Halves the window, but not below the minimum.
+ * @param writer
+ */
+static void bird_writer_decrease(struct bird_writer *writer)
+{
+    writer->window /= 2;
+    if (writer->window < writer->window_min)
+        writer->window = writer->window_min;
+    writer->window_decreases++;
+}
+
+/**
+ * Adapts the window to the latency of the last one: halves it if BIRD took
+ * longer than the latency target, grows it by one command after a full
+ * window answered in time. Commands BIRD rejected are data errors, not a
+ * sign of congestion, so `errors` is only logged.
+ * @param writer
+ * @param commands
+ * @param latency
+ * @param errors
+ */
+static void bird_writer_adapt(struct bird_writer *writer, size_t commands,
+                              uint64_t latency, unsigned int errors)
+{
+    const unsigned int window = writer->window;
+    writer->window_latency = latency;
+    if (latency > BIRD_WRITER_WINDOW_LATENCY) {
+        bird_writer_decrease(writer);
+    } else if (commands == writer->window &&
+               writer->window < writer->window_max) {
+        writer->window++;
+    }
+    // Log changes, but not every step of the sawtooth.
+    const uint64_t now = util_clock();
+    if (writer->window != window && now >= writer->window_logged +
+        BIRD_WRITER_WINDOW_LOG_INTERVAL * 1000000ull) {
+        syslog(LOG_INFO, "BIRD window for %s: %u commands, last one took "
+               "%.1f ms with %u errors", writer->socket_path, writer->window,
+               latency / 1e3, errors);
+        writer->window_logged = now;
+    }
+}
+
+/**
+ * Sends up to one window of updates to BIRD with a single write, reads the
+ * answers and adapts the window, which is also halved if the connection
+ * fails. Stores the number of updates done, i.e., answered or skipped, in
+ * `done`. Returns 0 on success or -1 if the connection failed.
+ * @param writer
+ * @param updates
+ * @param count
+ * @param done
+ * @return
+ */
+static int bird_writer_send(struct bird_writer *writer,
+                            const struct update *updates, size_t count,
+                            size_t *done)
+{
+    const size_t commands = count < writer->window ? count : writer->window;
+    size_t length = 0;
+    unsigned int errors = 0;
+    *done = 0;
+    // Write all commands of the window to the buffer.
+    for (size_t i = 0; i < commands; i++) {
+        const int command_length = bird_writer_format(writer, &updates[i],
+                                                      writer->window_buffer +
+                                                      length);
+        writer->window_lengths[i] = command_length > 0 ? command_length : 0;
+        if (command_length > 0 && !writer->quiet)
+            syslog(LOG_INFO, "To BIRD: %.*s", command_length - 1,
+                   writer->window_buffer + length);
+        length += writer->window_lengths[i];
+    }
+    const uint64_t begin = util_clock();
+    if (util_write_all(writer->socket, writer->window_buffer, length) != 0) {
+        bird_writer_decrease(writer);
+        return -1;
+    }
+    // Fetch the BIRD answers in order.
+    const char *command = writer->window_buffer;
+    for (size_t i = 0; i < commands; i++) {
+        if (writer->window_lengths[i] == 0) {
+            (*done)++;
+            continue;
+        }
+        const int code = bird_read_reply(writer->socket, &writer->reader,
+                                         writer->response,
+                                         sizeof(writer->response));
+        if (code < 0) {
+            bird_writer_decrease(writer);
+            return -1;
+        }
+        if (code >= BIRD_CODE_ERROR) {
+            syslog(LOG_ERR, "Bird command %.*s resulted in: %04d %s\n",
+                   (int) writer->window_lengths[i] - 1, command, code,
+                   writer->response);
+            errors++;
+        }
+        if (!writer->quiet)
+            syslog(LOG_INFO, "From BIRD: %04d %s", code, writer->response);
+        trace_bird_ack();
+        command += writer->window_lengths[i];
+        (*done)++;
+    }
+    bird_writer_adapt(writer, commands, util_clock() - begin, errors);
+    return 0;
+}
+
+/**
+ * Connects to BIRD and consumes its greeting. Returns the socket or -1 on
+ * failure.
+ * @param writer
+ * @return
+ */
+static int bird_writer_open(struct bird_writer *writer)
+{
+    int socket = bird_connect(writer->socket_path);
+    if (socket < 0)
+        return -1;
+    bird_reader_init(&writer->reader);
+    if (bird_read_reply(socket, &writer->reader, writer->response,
+                        sizeof(writer->response)) < 0) {
+        syslog(LOG_ERR, "No greeting from BIRD");
+        close(socket);
+        return -1;
+    }
+    syslog(LOG_INFO, "Connected to BIRD at %s: %s", writer->socket_path,
+           writer->response);
+    return socket;
+}
+
+/**
+ * Waits on the queue condition for at most the specified number of
+ * microseconds. Must be called with the writer mutex held.
+ * @param writer
+ * @param usec
+ */
+static void bird_writer_timedwait(struct bird_writer *writer, uint64_t usec)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    usec += deadline.tv_nsec / 1000;
+    deadline.tv_sec += usec / 1000000;
+    deadline.tv_nsec = (usec % 1000000) * 1000;
+    pthread_cond_timedwait(&writer->cond, &writer->mutex, &deadline);
+}
+
+/**
+ * Returns the prefix of an audit chunk: the IPv4 /8s, then the IPv6 /12s
+ * of 2000::/3 and finally ::/3, 4000::/2 and 8000::/1. Every ROA shorter
+ * than its chunk starts at the address of a chunk.
+ * @param chunk
+ * @param prefix
+ * @param prefix_len
+ */
+static void bird_writer_audit_prefix(unsigned int chunk,
+                                     struct lrtr_ip_addr *prefix,
+                                     uint8_t *prefix_len)
+{
+    memset(prefix, 0, sizeof (struct lrtr_ip_addr));
+    if (chunk < 256) {
+        prefix->ver = LRTR_IPV4;
+        prefix->u.addr4.addr = (uint32_t) chunk << 24;
+        *prefix_len = 8;
+    } else if (chunk < 256 + 512) {
+        prefix->ver = LRTR_IPV6;
+        prefix->u.addr6.addr[0] = (uint32_t) (0x200 + chunk - 256) << 20;
+        *prefix_len = 12;
+    } else {
+        static const uint32_t addr[] = {0, 0x40000000, 0x80000000};
+        static const uint8_t len[] = {3, 2, 1};
+        prefix->ver = LRTR_IPV6;
+        prefix->u.addr6.addr[0] = addr[chunk - 256 - 512];
+        *prefix_len = len[chunk - 256 - 512];
+    }
+}
+
+/**
+ * Parses a ROA "<prefix>/<length> max <max_length> as <asn>" as listed by
+ * `show roa`. Returns 0 on success or -1 on failure.
+ * @param text
+ * @param record
+ * @return
+ */
+static int bird_writer_parse_roa(const char *text, struct pfx_record *record)
+{
+    char address[INET6_ADDRSTRLEN];
+    unsigned int min_len, max_len, asn;
+    memset(record, 0, sizeof (struct pfx_record));
+    if (sscanf(text, "%45[^/]/%u max %u as %u", address, &min_len, &max_len,
+               &asn) != 4 || min_len > 128 || max_len > 128 ||
+        lrtr_ip_str_to_addr(address, &record->prefix) != 0)
+        return -1;
+    record->min_len = min_len;
+    record->max_len = max_len;
+    record->asn = asn;
+    return 0;
+}
+
+/**
+ * Lists the ROAs BIRD has within the specified prefix, or with `shorter`
+ * the shorter ROAs at its address, into the batch. Returns 0 on success, -1
+ * if the connection failed or -2 if BIRD answered with an error.
+ * @param writer
+ * @param prefix
+ * @param prefix_len
+ * @param shorter
+ * @param batch
+ * @return
+ */
+static int bird_writer_show(struct bird_writer *writer,
+                            const struct lrtr_ip_addr *prefix,
+                            uint8_t prefix_len, int shorter,
+                            struct update_batch *batch)
+{
+    char address[INET6_ADDRSTRLEN];
+    struct pfx_record record;
+    char *line;
+    int code;
+    lrtr_ip_addr_to_str(prefix, address, sizeof address);
+    const int length = snprintf(writer->command, writer->command_size,
+                                "show roa %s %s/%u%s\n",
+                                shorter ? "for" : "in", address, prefix_len,
+                                writer->table_arg);
+    if (length < 0 || (size_t) length >= writer->command_size)
+        return -2;
+    if (util_write_all(writer->socket, writer->command, length) != 0)
+        return -1;
+    while (bird_read_line(writer->socket, &writer->reader, &line) >= 0) {
+        if ((code = bird_line_code(line)) >= 0) {
+            if (code < BIRD_CODE_ERROR)
+                return 0;
+            syslog(LOG_ERR, "BIRD audit of %s failed: %s", writer->socket_path,
+                   line);
+            return -2;
+        }
+        // Skip the code of the first line of a reply and the space of the
+        // following ones.
+        const char *text = line[0] == ' ' ? line + 1 :
+            strlen(line) > 5 && line[4] == '-' ? line + 5 : 0;
+        if (!text || bird_writer_parse_roa(text, &record) != 0)
+            continue;
+        // `show roa for` also lists the covering ROAs at other addresses
+        // and the ones of the prefix length itself.
+        if (shorter && (record.min_len >= prefix_len ||
+                        !lrtr_ip_addr_equal(record.prefix, *prefix)))
+            continue;
+        if (update_batch_add(batch, &record, 1) != 0)
+            return -2;
+    }
+    return -1;
+}
+
+/**
+ * Appends a record of a store to the batch passed as data.
+ * @param record
+ * @param value
+ * @param data
+ */
+static void bird_writer_collect(const struct pfx_record *record, void *value,
+                                void *data)
+{
+    update_batch_add(data, record, 1);
+}
+
+/**
+ * Returns nonzero if the sorted batch has the record.
+ * @param batch
+ * @param record
+ * @return
+ */
+static int bird_writer_listed(const struct update_batch *batch,
+                              const struct pfx_record *record)
+{
+    size_t low = 0, high = batch->len;
+    while (low < high) {
+        const size_t mid = low + (high - low) / 2;
+        const int cmp = update_compare(&batch->updates[mid].record, record);
+        if (cmp == 0)
+            return 1;
+        if (cmp < 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return 0;
+}
+
+/**
+ * Removes the ROAs of a chunk from an audit store that BIRD no longer lists,
+ * using `scratch` to collect them.
+ * @param store
+ * @param prefix
+ * @param prefix_len
+ * @param actual
+ * @param scratch
+ */
+static void bird_writer_forget(struct vrp_store *store,
+                               const struct lrtr_ip_addr *prefix,
+                               uint8_t prefix_len,
+                               const struct update_batch *actual,
+                               struct update_batch *scratch)
+{
+    scratch->len = 0;
+    vrp_store_for_each_in(store, prefix, prefix_len, bird_writer_collect,
+                          scratch);
+    vrp_store_for_each_at(store, prefix, prefix_len, bird_writer_collect,
+                          scratch);
+    for (size_t i = 0; i < scratch->len; i++)
+        if (!bird_writer_listed(actual, &scratch->updates[i].record))
+            vrp_store_remove(store, &scratch->updates[i].record);
+}
+
+/**
+ * Compares the expected ROAs of a chunk with the ones BIRD listed and
+ * queues the updates repairing the difference, unless updates were queued
+ * since the expected ROAs were taken at the specified generation. Extra
+ * ROAs are deleted, except for those BIRD still lists after an earlier
+ * delete, e.g., static ones, which are only counted from then on.
+ * @param writer
+ * @param prefix
+ * @param prefix_len
+ * @param expected
+ * @param actual
+ * @param generation
+ */
+static void bird_writer_compare(struct bird_writer *writer,
+                                const struct lrtr_ip_addr *prefix,
+                                uint8_t prefix_len,
+                                struct update_batch *expected,
+                                struct update_batch *actual,
+                                unsigned long generation)
+{
+    size_t missing = 0, extra = 0, foreign = 0;
+    const int sorted = update_batch_sort(expected) == 0 &&
+        update_batch_sort(actual) == 0;
+    pthread_mutex_lock(&writer->mutex);
+    if (!sorted || generation != writer->generation) {
+        writer->stats.audit_discarded++;
+        pthread_mutex_unlock(&writer->mutex);
+        return;
+    }
+    for (size_t i = 0, j = 0; i < expected->len || j < actual->len;) {
+        const int cmp = i == expected->len ? 1 : j == actual->len ? -1 :
+            update_compare(&expected->updates[i].record,
+                           &actual->updates[j].record);
+        if (cmp == 0) {
+            vrp_store_remove(&writer->audit_deleted,
+                             &actual->updates[j].record);
+            i++;
+            j++;
+        } else if (cmp < 0) {
+            update_batch_add(&writer->pending, &expected->updates[i++].record,
+                             1);
+            missing++;
+        } else {
+            const struct pfx_record *record = &actual->updates[j++].record;
+            // BIRD kept it despite the delete of the last audit, so it is
+            // not ours to delete.
+            if (vrp_store_find(&writer->audit_refused, record, NULL) == 1 ||
+                vrp_store_remove(&writer->audit_deleted, record) == 1) {
+                vrp_store_add(&writer->audit_refused, record, NULL);
+                foreign++;
+            } else {
+                vrp_store_add(&writer->audit_deleted, record, NULL);
+                update_batch_add(&writer->pending, record, 0);
+                extra++;
+            }
+        }
+    }
+    // Deleted and refused ROAs gone from BIRD need no tracking anymore.
+    bird_writer_forget(&writer->audit_deleted, prefix, prefix_len, actual,
+                       expected);
+    bird_writer_forget(&writer->audit_refused, prefix, prefix_len, actual,
+                       expected);
+    writer->stats.audit_chunks++;
+    writer->stats.audit_missing += missing;
+    writer->stats.audit_extra += extra;
+    writer->stats.audit_foreign += foreign;
+    pthread_mutex_unlock(&writer->mutex);
+    if (missing || extra)
+        syslog(LOG_WARNING, "BIRD audit of %s: repairing %zu missing and "
+               "%zu extra ROAs", writer->socket_path, missing, extra);
+}
+
+/**
+ * Audits the next chunk of BIRD's ROA table. Returns 0 on success, 1 if the
+ * chunk was skipped or -1 if the connection failed.
+ * @param writer
+ * @param expected
+ * @param actual
+ * @return
+ */
+static int bird_writer_audit(struct bird_writer *writer,
+                             struct update_batch *expected,
+                             struct update_batch *actual)
+{
+    struct lrtr_ip_addr prefix;
+    uint8_t prefix_len;
+    int ret = 0;
+    bird_writer_audit_prefix(writer->audit_chunk, &prefix, &prefix_len);
+    if (writer->audit_chunk == 0)
+        writer->audit_cycle_begin = util_clock();
+    writer->audit_chunk = (writer->audit_chunk + 1) % BIRD_WRITER_AUDIT_CHUNKS;
+    // Updates queued from here on may make the comparison stale.
+    pthread_mutex_lock(&writer->mutex);
+    const unsigned long generation = writer->generation;
+    pthread_mutex_unlock(&writer->mutex);
+    expected->len = 0;
+    actual->len = 0;
+    if (writer->expect(writer, &prefix, prefix_len, expected,
+                       writer->load_data) != 0) {
+        ret = 1;
+    } else if ((ret = bird_writer_show(writer, &prefix, prefix_len, 0,
+                                       actual)) == 0 &&
+               (ret = bird_writer_show(writer, &prefix, prefix_len, 1,
+                                       actual)) == 0) {
+        bird_writer_compare(writer, &prefix, prefix_len, expected, actual,
+                            generation);
+    } else if (ret == -2) {
+        // Stop auditing until the next connection if BIRD refuses it.
+        writer->audit_next = UINT64_MAX;
+        return 0;
+    }
+    if (ret >= 0 && writer->audit_chunk == 0 && writer->audit_cycle_begin) {
+        pthread_mutex_lock(&writer->mutex);
+        writer->stats.audit_cycles++;
+        writer->stats.audit_cycle_seconds =
+            (util_clock() - writer->audit_cycle_begin) / 1e6;
+        const struct bird_writer_stats stats = writer->stats;
+        pthread_mutex_unlock(&writer->mutex);
+        syslog(LOG_INFO, "BIRD audit of %s took %.1f s, %lu missing and %lu "
+               "extra ROAs repaired so far", writer->socket_path,
+               stats.audit_cycle_seconds, stats.audit_missing,
+               stats.audit_extra);
+    }
+    return ret;
+}
+
+/**
+ * BIRD writer thread. Connects to BIRD, retrying until it is available,
+ * loads the full data set after every (re)connect and then sends the
+ * queued updates in batches.
+ * @param arg
+ * @return
+ */
+static void *bird_writer_thread(void *arg)
+{
+    struct bird_writer *writer = arg;
+    // Updates being sent.
+    struct update_batch batch;
+    update_batch_init(&batch);
+    // ROAs of the audited chunk, expected and listed by BIRD.
+    struct update_batch expected, actual;
+    update_batch_init(&expected);
+    update_batch_init(&actual);
+    // Whether the batch is new, i.e., not the unsent rest of a sent one.
+    int taken = 0;
+    pthread_mutex_lock(&writer->mutex);
+    while (!writer->stop) {
+        // (Re)connect to BIRD.
+        if (writer->socket < 0) {
+            pthread_mutex_unlock(&writer->mutex);
+            const int socket = bird_writer_open(writer);
+            pthread_mutex_lock(&writer->mutex);
+            if (socket < 0) {
+                bird_writer_timedwait(writer,
+                                      BIRD_WRITER_RETRY_INTERVAL * 1000000ull);
+                continue;
+            }
+            writer->socket = socket;
+            writer->audit_next = util_clock() +
+                writer->audit_interval * 1000000ull;
+            // BIRD may have been restarted with a different configuration.
+            vrp_store_clear(&writer->audit_deleted);
+            vrp_store_clear(&writer->audit_refused);
+            trace_phase_end(TRACE_PHASE_BIRD_CONNECT);
+            // BIRD has none of our ROAs after a (re)start, so load the full
+            // set. Updates queued from here on are sent after it.
+            if (writer->load) {
+                writer->busy = 1;
+                batch.len = 0;
+                pthread_mutex_unlock(&writer->mutex);
+                writer->load(writer, &batch, writer->load_data);
+                pthread_mutex_lock(&writer->mutex);
+                syslog(LOG_INFO, "Loading %zu ROAs into BIRD", batch.len);
+                taken = 1;
+            }
+        }
+        // Take all pending updates, wait for some if there are none.
+        if (batch.len == 0) {
+            if (writer->pending.len == 0) {
+                writer->busy = 0;
+                pthread_cond_broadcast(&writer->idle_cond);
+                if (writer->sync_done)
+                    trace_bird_load_done();
+                // Audit a chunk of BIRD's ROA table when due, once the
+                // initial sync is done.
+                if (writer->expect && writer->audit_interval &&
+                    writer->sync_done && writer->audit_next != UINT64_MAX) {
+                    const uint64_t now = util_clock();
+                    if (now < writer->audit_next) {
+                        bird_writer_timedwait(writer, writer->audit_next - now);
+                        continue;
+                    }
+                    writer->audit_next = now +
+                        writer->audit_interval * 1000000ull;
+                    pthread_mutex_unlock(&writer->mutex);
+                    const int ret = bird_writer_audit(writer, &expected,
+                                                      &actual);
+                    pthread_mutex_lock(&writer->mutex);
+                    // Skipped chunks take no time of their own.
+                    if (ret == 1) {
+                        writer->audit_next = now;
+                    } else if (ret != 0) {
+                        syslog(LOG_ERR, "BIRD connection lost, reconnecting!");
+                        close(writer->socket);
+                        writer->socket = -1;
+                    }
+                    continue;
+                }
+                pthread_cond_wait(&writer->cond, &writer->mutex);
+                continue;
+            }
+            const struct update_batch queued = writer->pending;
+            writer->pending = batch;
+            batch = queued;
+            taken = 1;
+        }
+        writer->busy = 1;
+        pthread_mutex_unlock(&writer->mutex);
+        // Sort large batches for insertion locality in BIRD's ROA table and
+        // to drop updates superseded within the batch.
+        const uint64_t trace_begin = trace_sample() ? trace_now() : 0;
+        if (taken && writer->sort_threshold &&
+            batch.len >= writer->sort_threshold) {
+            if (update_batch_sort(&batch) != 0)
+                syslog(LOG_ERR, "Could not sort a batch of %zu updates",
+                       batch.len);
+            if (trace_begin)
+                trace_span("bird_sort", trace_begin, trace_now());
+        }
+        taken = 0;
+        // Send the batch window by window.
+        size_t sent = 0, done;
+        while (sent < batch.len) {
+            const int ret = bird_writer_send(writer, &batch.updates[sent],
+                                             batch.len - sent, &done);
+            sent += done;
+            if (ret != 0)
+                break;
+        }
+        if (trace_begin)
+            trace_span("bird_batch", trace_begin, trace_now());
+        pthread_mutex_lock(&writer->mutex);
+        writer->stats.sent += sent;
+        writer->stats.window = writer->window;
+        writer->stats.window_latency = writer->window_latency;
+        writer->stats.window_decreases = writer->window_decreases;
+        if (sent < batch.len) {
+            syslog(LOG_ERR, "BIRD connection lost, reconnecting!");
+            close(writer->socket);
+            writer->socket = -1;
+            // The full load after reconnecting supersedes the rest, without
+            // a load function (i.e., when replaying) the rest is sent again.
+            if (writer->load)
+                batch.len = 0;
+            else
+                update_batch_drop(&batch, sent);
+        } else {
+            batch.len = 0;
+        }
+    }
+    pthread_mutex_unlock(&writer->mutex);
+    update_batch_free(&batch);
+    update_batch_free(&expected);
+    update_batch_free(&actual);
+    return NULL;
+}
+
+int bird_writer_start(struct bird_writer *writer)
+{
+    // Buffers for a window of the largest size, start with the smallest.
+    if (writer->window_min < 1)
+        writer->window_min = 1;
+    if (writer->window_max < writer->window_min)
+        writer->window_max = writer->window_min;
+    writer->window = writer->window_min;
+    writer->window_buffer = malloc(writer->window_max * writer->command_size);
+    writer->window_lengths = malloc(writer->window_max * sizeof (size_t));
+    if (!writer->window_buffer || !writer->window_lengths)
+        return -1;
+    trace_phase_begin(TRACE_PHASE_BIRD_CONNECT);
+    if (pthread_create(&writer->thread, NULL, bird_writer_thread,
+                       writer) != 0)
+        return -1;
+    writer->started = 1;
+    return 0;
+}
+
+void bird_writer_stop(struct bird_writer *writer)
+{
+    if (!writer->started)
+        return;
+    pthread_mutex_lock(&writer->mutex);
+    writer->stop = 1;
+    pthread_cond_broadcast(&writer->cond);
+    pthread_mutex_unlock(&writer->mutex);
+    pthread_join(writer->thread, NULL);
+    writer->started = 0;
+    if (writer->socket >= 0)
+        close(writer->socket);
+    writer->socket = -1;
+}
+
+void bird_writer_enqueue(struct bird_writer *writer,
+                         const struct pfx_record *record, int added)
+{
+    pthread_mutex_lock(&writer->mutex);
+    // While BIRD is away, the full load after connecting covers the update.
+    if (writer->socket >= 0 || !writer->load) {
+        if (update_batch_add(&writer->pending, record, added) != 0)
+            syslog(LOG_ERR, "Failed to queue BIRD update");
+        writer->generation++;
+        pthread_cond_signal(&writer->cond);
+    }
+    pthread_mutex_unlock(&writer->mutex);
+}
+
+void bird_writer_clear(struct bird_writer *writer)
+{
+    pthread_mutex_lock(&writer->mutex);
+    writer->pending.len = 0;
+    writer->generation++;
+    pthread_mutex_unlock(&writer->mutex);
+}
+
+void bird_writer_sync_done(struct bird_writer *writer)
+{
+    pthread_mutex_lock(&writer->mutex);
+    writer->sync_done = 1;
+    pthread_cond_signal(&writer->cond);
+    pthread_mutex_unlock(&writer->mutex);
+}
+
+void bird_writer_wait_idle(struct bird_writer *writer, volatile int *stop)
+{
+    pthread_mutex_lock(&writer->mutex);
+    while ((writer->pending.len > 0 || writer->busy) && !*stop) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += 1;
+        pthread_cond_timedwait(&writer->idle_cond, &writer->mutex, &deadline);
+    }
+    pthread_mutex_unlock(&writer->mutex);
+}
+
+int bird_writer_drain(struct bird_writer *writer, unsigned int timeout)
+{
+    struct timespec deadline;
+    int ret = 0;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout;
+    pthread_mutex_lock(&writer->mutex);
+    while (writer->started && (writer->pending.len > 0 || writer->busy)) {
+        if (pthread_cond_timedwait(&writer->idle_cond, &writer->mutex,
+                                   &deadline) != 0) {
+            ret = writer->pending.len > 0 || writer->busy ? -1 : 0;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&writer->mutex);
+    return ret;
+}
+
+int bird_writer_in_sync(struct bird_writer *writer)
+{
+    pthread_mutex_lock(&writer->mutex);
+    const int in_sync = writer->sync_done && writer->socket >= 0 &&
+        !writer->busy && writer->pending.len == 0;
+    pthread_mutex_unlock(&writer->mutex);
+    return in_sync;
+}
+
+void bird_writer_get_stats(struct bird_writer *writer,
+                           struct bird_writer_stats *stats)
+{
+    pthread_mutex_lock(&writer->mutex);
+    *stats = writer->stats;
+    stats->queued = writer->pending.len;
+    pthread_mutex_unlock(&writer->mutex);
+}
@@ -0,0 +1,253 @@
+/*
+ * This file is part of BIRD-RTRlib-CLI.
+ *
+ * BIRD-RTRlib-CLI is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * BIRD-RTRlib-CLI is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with BIRD-RTRlib-CLI; see the file COPYING.
+ *
+ * written by smlng and Mehmet Ceyran, in cooperation with:
+ * CST group, Freie Universitaet Berlin
+ * Website: https://github.com/rtrlib/bird-rtrlib-cli
+ */
+
+
+#ifndef BIRD_RTRLIB_CLI__WRITER_H
+#define	BIRD_RTRLIB_CLI__WRITER_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bird.h"
+#include "update.h"
+#include "vrp.h"
+#include <rtrlib/rtrlib.h>
+
+/// Size of the buffer for the text of a BIRD reply.
+#define BIRD_WRITER_RESPONSE_SIZE (200)
+/// Seconds between attempts to connect to BIRD.
+#define BIRD_WRITER_RETRY_INTERVAL (1)
+/// Default maximum number of commands sent to BIRD before reading answers.
+#define BIRD_WRITER_WINDOW_MAX (64)
+/// Microseconds BIRD may take to answer a window before it is halved.
+#define BIRD_WRITER_WINDOW_LATENCY (20000)
+/// Seconds BIRD gets at exit to acknowledge the withdrawals of the tool.
+#define BIRD_WRITER_DRAIN_TIMEOUT (5)
+/// Seconds between log messages about window changes.
+#define BIRD_WRITER_WINDOW_LOG_INTERVAL (60)
+/// Number of audit chunks: the IPv4 /8s, the IPv6 /12s in 2000::/3 and
+/// ::/3, 4000::/2 and 8000::/1 for the rest of the IPv6 space.
+#define BIRD_WRITER_AUDIT_CHUNKS (256 + 512 + 3)
+
+struct bird_writer;
+
+/**
+ * Function called by the writer thread after every (re)connect to fill
+ * `batch` with the full ROA set for BIRD. It must drop the queued updates
+ * with `bird_writer_clear()` atomically with taking the set, i.e., while no
+ * update can be queued.
+ */
+typedef void (*bird_writer_load_fp)(struct bird_writer *writer,
+                                    struct update_batch *batch, void *data);
+
+/**
+ * Function called by the writer thread to fill `batch` with the ROAs BIRD
+ * should have within the specified prefix and the shorter ones at its
+ * address, for auditing BIRD's table. It gets the `load_data` of the writer
+ * and returns -1 to skip the prefix.
+ */
+typedef int (*bird_writer_expect_fp)(struct bird_writer *writer,
+                                     const struct lrtr_ip_addr *prefix,
+                                     uint8_t prefix_len,
+                                     struct update_batch *batch, void *data);
+
+/**
+ * Counters of a writer.
+ */
+struct bird_writer_stats {
+    // Updates acknowledged by BIRD and updates waiting in the queue.
+    unsigned long sent;
+    size_t queued;
+    // Current window, latency of the last one in microseconds and the
+    // number of times it was halved.
+    unsigned int window;
+    uint64_t window_latency;
+    unsigned long window_decreases;
+    // Audited chunks, and chunks discarded because of concurrent updates.
+    unsigned long audit_chunks;
+    unsigned long audit_discarded;
+    // ROAs missing in BIRD that were added again, ROAs only in BIRD that
+    // were deleted, and ROAs only in BIRD that survived a delete, e.g.,
+    // static ones, which are left alone.
+    unsigned long audit_missing;
+    unsigned long audit_extra;
+    unsigned long audit_foreign;
+    // Completed audits of the whole table and the duration of the last one.
+    unsigned long audit_cycles;
+    double audit_cycle_seconds;
+};
+
+/**
+ * Connection to one BIRD control socket with a queue of updates and the
+ * thread sending them. All state of a BIRD target lives here, so several
+ * writers work independently. With an expect function and an audit
+ * interval, the idle writer compares one chunk of BIRD's ROA table per
+ * interval with the expected ROAs and queues repairs for any drift. Extra
+ * ROAs are deleted whoever added them, e.g., an earlier run, unless BIRD
+ * kept one despite a delete, like a static ROA.
+ * Commands are pipelined: a window of them is written at once before the
+ * answers are read, and the window adapts between `window_min` and
+ * `window_max` by AIMD on the answer latency. The batch, i.e., all updates
+ * queued when the writer takes them, is not sized: it is sent window by
+ * window, so the window alone bounds what BIRD has in flight, and a smaller
+ * batch would only coalesce fewer updates into more commands.
+ */
+struct bird_writer {
+    // Configuration.
+    char *socket_path;
+    char *table_arg;
+    unsigned int sort_threshold;
+    unsigned int window_min;
+    unsigned int window_max;
+    int quiet;
+    bird_writer_load_fp load;
+    bird_writer_expect_fp expect;
+    void *load_data;
+    unsigned int audit_interval;
+    // Connection, used by the writer thread only.
+    int socket;
+    struct bird_reader reader;
+    char *command;
+    size_t command_size;
+    char response[BIRD_WRITER_RESPONSE_SIZE];
+    // Pipelined commands and their lengths, and the adaptive window.
+    char *window_buffer;
+    size_t *window_lengths;
+    unsigned int window;
+    uint64_t window_latency;
+    unsigned long window_decreases;
+    uint64_t window_logged;
+    // Queue, protected by the mutex.
+    struct update_batch pending;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    pthread_cond_t idle_cond;
+    pthread_t thread;
+    int started;
+    int stop;
+    int busy;
+    int sync_done;
+    unsigned long generation;
+    struct bird_writer_stats stats;
+    // Audit state, used by the writer thread only.
+    unsigned int audit_chunk;
+    uint64_t audit_next;
+    uint64_t audit_cycle_begin;
+    // Extra ROAs deleted by the audit and the ones BIRD kept nevertheless,
+    // which are not deleted again. Entries that BIRD no longer lists are
+    // dropped when their chunk is audited again.
+    struct vrp_store audit_deleted;
+    struct vrp_store audit_refused;
+};
+
+/**
+ * Initializes a writer for the BIRD control socket at the specified path,
+ * adding ROAs to the specified table or BIRD's default table if NULL. With a
+ * load function, BIRD gets the full set after every (re)connect, without one
+ * every queued update is sent once. Returns 0 on success or -1 on failure.
+ * @param writer
+ * @param socket_path
+ * @param roa_table
+ * @param load
+ * @param load_data
+ * @return
+ */
+int bird_writer_init(struct bird_writer *writer, const char *socket_path,
+                     const char *roa_table, bird_writer_load_fp load,
+                     void *load_data);
+
+/**
+ * Releases the memory of a stopped writer.
+ * @param writer
+ */
+void bird_writer_free(struct bird_writer *writer);
+
+/**
+ * Starts the writer thread, which connects to BIRD in the background.
+ * Returns 0 on success or -1 on failure.
+ * @param writer
+ * @return
+ */
+int bird_writer_start(struct bird_writer *writer);
+
+/**
+ * Stops the writer thread and closes the connection.
+ * @param writer
+ */
+void bird_writer_stop(struct bird_writer *writer);
+
+/**
+ * Queues an update for BIRD. While BIRD is not connected, updates are
+ * dropped if the writer has a load function, which covers them.
+ * @param writer
+ * @param record
+ * @param added
+ */
+void bird_writer_enqueue(struct bird_writer *writer,
+                         const struct pfx_record *record, int added);
+
+/**
+ * Drops all queued updates.
+ * @param writer
+ */
+void bird_writer_clear(struct bird_writer *writer);
+
+/**
+ * Marks the initial RTR sync as done, the writer ends the BIRD load trace
+ * phase once it has sent everything afterwards.
+ * @param writer
+ */
+void bird_writer_sync_done(struct bird_writer *writer);
+
+/**
+ * Returns nonzero if the writer is connected, the initial sync is done and
+ * BIRD has acknowledged all queued updates.
+ * @param writer
+ * @return
+ */
+int bird_writer_in_sync(struct bird_writer *writer);
+
+/**
+ * Copies the counters of the writer.
+ * @param writer
+ * @param stats
+ */
+void bird_writer_get_stats(struct bird_writer *writer,
+                           struct bird_writer_stats *stats);
+
+/**
+ * Waits until all queued updates have been sent to BIRD or `*stop` is set.
+ * @param writer
+ * @param stop
+ */
+void bird_writer_wait_idle(struct bird_writer *writer, volatile int *stop);
+
+/**
+ * Waits at most `timeout` seconds until all queued updates have been sent to
+ * BIRD. Returns 0 on success or -1 if updates are left.
+ * @param writer
+ * @param timeout
+ * @return
+ */
+int bird_writer_drain(struct bird_writer *writer, unsigned int timeout);
+
+#endif // BIRD_RTRLIB_CLI__WRITER_H